@@ -0,0 +1,210 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "AndersonAccelerator.h"
+#include "BucketPETScBase.h"
+#include "Logger.h"
+#include <dolfin.h>
+#include <cmath>
+
+using namespace buckettools;
+
+//*******************************************************************|************************************************************//
+// specific constructor
+//*******************************************************************|************************************************************//
+AndersonAccelerator::AndersonAccelerator(const dolfin::PETScVector &vector,
+                                         const int &depth,
+                                         const double &beta) :
+                                         depth_(depth), beta_(beta),
+                                         nstored_(0), head_(0), havelast_(false)
+{
+  PetscErrorCode perr;
+
+  if (depth_ < 1)
+  {
+    tf_err("Anderson acceleration requires a history depth of at least 1.", "depth = %d", depth_);
+  }
+
+  perr = VecDuplicateVecs(vector.vec(), depth_, &df_); petsc_err(perr);// allocate the rings of history vectors once
+  perr = VecDuplicateVecs(vector.vec(), depth_, &dg_); petsc_err(perr);
+  perr = VecDuplicate(vector.vec(), &f_); petsc_err(perr);
+  perr = VecDuplicate(vector.vec(), &fold_); petsc_err(perr);
+  perr = VecDuplicate(vector.vec(), &gold_); petsc_err(perr);
+}
+
+//*******************************************************************|************************************************************//
+// default destructor
+//*******************************************************************|************************************************************//
+AndersonAccelerator::~AndersonAccelerator()
+{
+  PetscErrorCode perr;
+
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 1
+  perr = VecDestroyVecs(depth_, &df_); petsc_err(perr);
+  perr = VecDestroyVecs(depth_, &dg_); petsc_err(perr);
+  perr = VecDestroy(&f_); petsc_err(perr);
+  perr = VecDestroy(&fold_); petsc_err(perr);
+  perr = VecDestroy(&gold_); petsc_err(perr);
+  #else
+  perr = VecDestroyVecs(df_, depth_); petsc_err(perr);
+  perr = VecDestroyVecs(dg_, depth_); petsc_err(perr);
+  perr = VecDestroy(f_); petsc_err(perr);
+  perr = VecDestroy(fold_); petsc_err(perr);
+  perr = VecDestroy(gold_); petsc_err(perr);
+  #endif
+}
+
+//*******************************************************************|************************************************************//
+// forget the stored history
+//*******************************************************************|************************************************************//
+void AndersonAccelerator::reset()
+{
+  nstored_ = 0;
+  head_ = 0;
+  havelast_ = false;
+}
+
+//*******************************************************************|************************************************************//
+// given the input, x, and output, g, of the last fixed point iteration overwrite x with the accelerated next iterate
+//   x_{k+1} = g_k - dG gamma - (1-beta)(f_k - dF gamma)
+// where f_k = g_k - x_k and gamma minimizes ||f_k - dF gamma||_2 over the stored residual differences dF
+//*******************************************************************|************************************************************//
+void AndersonAccelerator::update(dolfin::GenericVector &x, const dolfin::GenericVector &g)
+{
+  PetscErrorCode perr;
+
+  Vec xvec = dolfin::as_type<dolfin::PETScVector>(x).vec();
+  Vec gvec = dolfin::as_type<const dolfin::PETScVector>(g).vec();
+
+  perr = VecWAXPY(f_, -1.0, xvec, gvec); petsc_err(perr);            // f_k = g_k - x_k
+
+  if (havelast_)                                                     // add the latest differences to the rings (overwriting the
+  {                                                                  // oldest entries once the rings are full)
+    perr = VecWAXPY(df_[head_], -1.0, fold_, f_); petsc_err(perr);
+    perr = VecWAXPY(dg_[head_], -1.0, gold_, gvec); petsc_err(perr);
+    head_ = (head_+1)%depth_;
+    nstored_ = std::min(nstored_+1, depth_);
+  }
+
+  perr = VecCopy(f_, fold_); petsc_err(perr);
+  perr = VecCopy(gvec, gold_); petsc_err(perr);
+  havelast_ = true;
+
+  std::vector<PetscScalar> gamma(nstored_, 0.0);
+  if (nstored_ > 0 && solve_leastsquares_(gamma))
+  {
+    for (std::vector<PetscScalar>::iterator g_it = gamma.begin(); g_it != gamma.end(); g_it++)
+    {
+      *g_it = -(*g_it);
+    }
+
+    perr = VecCopy(gvec, xvec); petsc_err(perr);
+    perr = VecMAXPY(xvec, nstored_, &gamma[0], dg_); petsc_err(perr);// x = g_k - dG gamma
+    if (beta_ != 1.0)
+    {
+      perr = VecMAXPY(f_, nstored_, &gamma[0], df_); petsc_err(perr);// f = f_k - dF gamma
+      perr = VecAXPY(xvec, beta_-1.0, f_); petsc_err(perr);
+    }
+  }
+  else                                                               // no (usable) history so fall back on simple relaxation
+  {
+    perr = VecAXPY(xvec, beta_, f_); petsc_err(perr);                // x = x_k + beta f_k
+  }
+
+  log(DBG, "  Anderson acceleration using %d of %d history vectors", nstored_, depth_);
+}
+
+//*******************************************************************|************************************************************//
+// solve the (small, dense) least squares problem for the coefficients gamma through its (regularized) normal equations
+// returns false if the problem is too poorly conditioned to be used
+//*******************************************************************|************************************************************//
+bool AndersonAccelerator::solve_leastsquares_(std::vector<PetscScalar> &gamma)
+{
+  PetscErrorCode perr;
+  const int m = nstored_;
+  std::vector<PetscScalar> A(m*m), b(m);
+
+  perr = VecMDot(f_, m, df_, &b[0]); petsc_err(perr);                // b_i = dF_i . f_k
+  for (int i = 0; i < m; i++)
+  {
+    perr = VecMDot(df_[i], m, df_, &A[i*m]); petsc_err(perr);        // A_ij = dF_i . dF_j
+  }
+
+  double trace = 0.0;
+  for (int i = 0; i < m; i++)
+  {
+    trace += A[i*m+i];
+  }
+  if (trace <= 0.0)
+  {
+    return false;
+  }
+  for (int i = 0; i < m; i++)
+  {
+    A[i*m+i] += 1.e-12*trace;                                        // small tikhonov regularization
+  }
+
+  for (int k = 0; k < m; k++)                                        // gaussian elimination with partial pivoting
+  {
+    int p = k;
+    for (int i = k+1; i < m; i++)
+    {
+      if (std::abs(A[i*m+k]) > std::abs(A[p*m+k]))
+      {
+        p = i;
+      }
+    }
+    if (std::abs(A[p*m+k]) <= 1.e-14*trace)
+    {
+      return false;
+    }
+    if (p != k)
+    {
+      for (int j = 0; j < m; j++)
+      {
+        std::swap(A[k*m+j], A[p*m+j]);
+      }
+      std::swap(b[k], b[p]);
+    }
+    for (int i = k+1; i < m; i++)
+    {
+      const PetscScalar factor = A[i*m+k]/A[k*m+k];
+      for (int j = k; j < m; j++)
+      {
+        A[i*m+j] -= factor*A[k*m+j];
+      }
+      b[i] -= factor*b[k];
+    }
+  }
+
+  for (int i = m-1; i >= 0; i--)                                     // back substitution
+  {
+    PetscScalar sum = b[i];
+    for (int j = i+1; j < m; j++)
+    {
+      sum -= A[i*m+j]*gamma[j];
+    }
+    gamma[i] = sum/A[i*m+i];
+  }
+
+  return true;
+}
+
@@ -26,6 +26,7 @@
 #include "EventHandler.h"
 #include "StatisticsFile.h"
 #include "Logger.h"
+#include "BucketPETScBase.h"
 #include <signal.h>
 #include <time.h>
 
@@ -37,7 +38,12 @@ boost::timer::cpu_timer Bucket::timer_;
 //*******************************************************************|************************************************************//
 // default constructor
 //*******************************************************************|************************************************************//
-Bucket::Bucket()
+Bucket::Bucket() : timestep_erroratol_(0.0), timestep_safety_(0.9), 
+                   timestep_minimum_(0.0), timestep_maxrejections_(10),
+                   lazysolves_(false), lazychangetol_(0.0), 
+                   binary_diagnostics_(false), timestep_rejections_(0), timestep_errorold_(1.0), 
+                   timestep_errordt_(HUGE_VAL), oldtimestep_(0.0), 
+                   stateoldtime_(0.0), iterationsfailed_(false)
 {
                                                                      // do nothing
 }
@@ -45,7 +51,13 @@ Bucket::Bucket()
 //*******************************************************************|************************************************************//
 // specific constructor
 //*******************************************************************|************************************************************//
-Bucket::Bucket(const std::string &name) : name_(name)
+Bucket::Bucket(const std::string &name) : timestep_erroratol_(0.0), timestep_safety_(0.9), 
+                                           timestep_minimum_(0.0), timestep_maxrejections_(10),
+                                           lazysolves_(false), lazychangetol_(0.0),
+                                           binary_diagnostics_(false), name_(name), timestep_rejections_(0), 
+                                           timestep_errorold_(1.0), timestep_errordt_(HUGE_VAL), 
+                                           oldtimestep_(0.0), stateoldtime_(0.0), 
+                                           iterationsfailed_(false)
 {
                                                                      // do nothing
 }
@@ -97,6 +109,11 @@ void Bucket::run()
   while (continue_timestepping) 
   {                                                                  // loop over time
 
+    if (timestep_rejections_ == 0)                                   // store the state so this timestep can be rolled back (unless
+    {                                                                // we're retrying a rejected timestep)
+      store_state_();
+    }
+
     *old_time_ = *current_time_;                                     // old time is now the previous time??
     *current_time_ += timestep();                                    // increment time with the timestep 
                                                                      // (we do this now so that time dependent expressions are
@@ -116,9 +133,17 @@ void Bucket::run()
 
     solve_in_timeloop_();                                            // this is where the magic happens
 
+    if (!accept_timestep_())                                         // the timestep failed or was too inaccurate so roll it back
+    {                                                                // and retry it with the reduced timestep
+      rollback_timestep_();
+      continue;
+    }
+
     update_timedependent();
     update_nonlinear();
 
+    advect_detectors();                                              // only once the timestep has been accepted
+
     if(complete())                                                   // this must be called before the update as it checks if a
     {                                                                // steady state has been attained
       output(OUTPUT_END);                                            // force an output at the end
@@ -148,7 +173,7 @@ void Bucket::solve(const int &location)
   for (SystemBucket_const_it s_it = systems_begin(); 
                              s_it != systems_end(); s_it++)
   {
-    bool solved = (*(*s_it).second).solve(location);
+    solve_system_((*s_it).second, location);
   }
 }
 
@@ -181,7 +206,7 @@ void Bucket::update()
 //*******************************************************************|************************************************************//
 void Bucket::update_timestep()
 {
-  if (timestep_constraints_.size()==0)                               // this indicates we don't have adaptive timestepping turned on
+  if (timestep_constraints_.size()==0 && !timestep_errortol_)        // this indicates we don't have adaptive timestepping turned on
   {
     return;                                                          // so return
   }
@@ -195,7 +220,7 @@ void Bucket::update_timestep()
                                   timestepadapt_time_, 
                                   timestepadapt_period_timesteps_);  // do we want to update the timestep now
 
-  if ((!adapt_dt) && (!zero_init_dt))
+  if ((!adapt_dt) && (!zero_init_dt) && (!timestep_errortol_))
   {
     return;
   }
@@ -203,6 +228,11 @@ void Bucket::update_timestep()
   double new_dt = HUGE_VAL;
   log(INFO, "In update_timestep()");
 
+  if (timestep_errortol_)                                            // start from the timestep proposed by the error controller
+  {
+    new_dt = timestep_errordt_;
+  }
+
   if (zero_init_dt)                                                  // the timestep is zero initially so we'll get a 0.0 Courant
   {                                                                  // like number... so set a dummy timestep of 1.0 for this
     *(timestep_.second) = 1.0;                                       // calculation
@@ -214,6 +244,11 @@ void Bucket::update_timestep()
        c_it != timestep_constraints_.end(); 
        c_it++)
   {
+    if ((!adapt_dt) && (!zero_init_dt))                              // only here because of the error controller
+    {
+      break;
+    }
+
     double suggested_dt;
 
     (*(*c_it).first).refresh(zero_init_dt);
@@ -234,6 +269,11 @@ void Bucket::update_timestep()
   {
     new_dt = std::min(timestep()*(*timestep_increasetol_), new_dt);
   }
+
+  if (timestep_errortol_ && !zero_init_dt && new_dt == HUGE_VAL)     // nothing proposed a timestep so leave it alone
+  {
+    return;
+  }
  
   *(timestep_.second) = new_dt;
 
@@ -251,6 +291,18 @@ void Bucket::update_timedependent()
   }
 }
 
+//*******************************************************************|************************************************************//
+// loop over the detectors in the bucket, calling advect on each of them (which only moves lagrangian detectors)
+//*******************************************************************|************************************************************//
+void Bucket::advect_detectors()
+{
+  for (GenericDetectors_const_it d_it = detectors_begin(); 
+                                 d_it != detectors_end(); d_it++)
+  {
+    (*(*d_it).second).advect();
+  }
+}
+
 //*******************************************************************|************************************************************//
 // loop over the ordered systems in the bucket, calling update_nonlinear on each of them
 //*******************************************************************|************************************************************//
@@ -265,13 +317,64 @@ void Bucket::update_nonlinear()
 
 //*******************************************************************|************************************************************//
 // loop over the ordered systems in the bucket, calling update_iterated on each of them
+// if the nonlinear systems iterations are anderson accelerated then the (old) iterated vectors of all the systems are stacked and
+// accelerated together as a single coupled fixed point iteration instead
 //*******************************************************************|************************************************************//
 void Bucket::update_iterated()
 {
-  for (SystemBucket_const_it s_it = systems_begin(); 
-                             s_it != systems_end(); s_it++)
+  if (anderson_)
+  {
+    PetscErrorCode perr;
+    PetscScalar *xarray, *garray;
+    perr = VecGetArray((*andersonx_).vec(), &xarray); petsc_err(perr);
+    perr = VecGetArray((*andersong_).vec(), &garray); petsc_err(perr);
+
+    std::vector<double> values;
+    std::size_t offset = 0;
+    for (SystemBucket_const_it s_it = systems_begin();               // stack the input (olditerated) and output (iterated) of this
+                               s_it != systems_end(); s_it++)        // iteration of every system
+    {
+      if ((*(*s_it).second).fields_size() > 0)
+      {
+        (*(*(*(*s_it).second).olditeratedfunction()).vector()).get_local(values);
+        std::copy(values.begin(), values.end(), xarray+offset);
+        (*(*(*(*s_it).second).iteratedfunction()).vector()).get_local(values);
+        std::copy(values.begin(), values.end(), garray+offset);
+        offset += values.size();
+      }
+    }
+
+    perr = VecRestoreArray((*andersong_).vec(), &garray); petsc_err(perr);
+    perr = VecRestoreArray((*andersonx_).vec(), &xarray); petsc_err(perr);
+
+    (*anderson_).update(*andersonx_, *andersong_);                   // overwrites the stacked input with the accelerated iterate
+
+    perr = VecGetArray((*andersonx_).vec(), &xarray); petsc_err(perr);
+
+    offset = 0;
+    for (SystemBucket_const_it s_it = systems_begin();               // unstack the accelerated iterate back into the systems
+                               s_it != systems_end(); s_it++)
+    {
+      if ((*(*s_it).second).fields_size() > 0)
+      {
+        GenericVector_ptr iterated = (*(*(*s_it).second).iteratedfunction()).vector();
+        values.assign(xarray+offset, xarray+offset+(*iterated).local_size());
+        (*iterated).set_local(values);
+        (*iterated).apply("insert");
+        offset += values.size();
+        *(*(*(*s_it).second).olditeratedfunction()).vector() = *iterated;
+      }
+    }
+
+    perr = VecRestoreArray((*andersonx_).vec(), &xarray); petsc_err(perr);
+  }
+  else
   {
-    (*(*s_it).second).update_iterated();
+    for (SystemBucket_const_it s_it = systems_begin(); 
+                               s_it != systems_end(); s_it++)
+    {
+      (*(*s_it).second).update_iterated();
+    }
   }
 }
 
@@ -354,7 +457,19 @@ double Bucket::residual_norm()
   for (SystemBucket_it s_it = systems_begin(); 
                        s_it != systems_end(); s_it++)
   {
-    norm += std::pow((*(*s_it).second).residual_norm(SOLVE_TIMELOOP), 2.0);
+    if ((*(*s_it).second).substeps() > 1)                            // the residual of a subcycled system can only be evaluated
+    {                                                                // at its final substep so use the value recorded there
+      norm += std::pow((*(*s_it).second).last_residual_norm(), 2.0);
+    }
+    else if ((*(*s_it).second).skipped() &&                          // a system skipped by the lazy solves whose inputs have
+             (*(*s_it).second).input_change() <= lazychangetol_)     // still hardly changed keeps the residual norm it was
+    {                                                                // skipped with rather than reassembling it
+      norm += std::pow((*(*s_it).second).last_residual_norm(), 2.0);
+    }
+    else
+    {
+      norm += std::pow((*(*s_it).second).residual_norm(SOLVE_TIMELOOP), 2.0);
+    }
   }
 
   norm = std::sqrt(norm);
@@ -1275,6 +1390,66 @@ const std::string Bucket::uflsymbols_str(const int &indent) const
   return s.str();
 }
 
+//*******************************************************************|************************************************************//
+// build the dependency graph of the systems from the coefficients of their solver forms, recording the systems each system
+// depends on and the systems that depend on it
+//*******************************************************************|************************************************************//
+void Bucket::fill_systemdependencies_()
+{
+  std::vector< SystemBucket_ptr > systems;
+  for (SystemBucket_const_it s_it = systems_begin(); 
+                             s_it != systems_end(); s_it++)
+  {
+    systems.push_back((*s_it).second);
+  }
+
+  const std::size_t nsystems = systems.size();
+  systemdependents_.clear();
+  systemdependencies_.clear();
+  for (std::size_t i = 0; i < nsystems; i++)
+  {
+    for (std::size_t j = 0; j < nsystems; j++)
+    {
+      if (i != j && (*systems[i]).depends_on(*systems[j]))
+      {
+        systemdependents_[&(*systems[j])].push_back(systems[i]);
+        systemdependencies_[&(*systems[i])].push_back(systems[j]);
+      }
+    }
+  }
+}
+
+//*******************************************************************|************************************************************//
+// allocate the anderson acceleration of the nonlinear systems iterations (if requested)
+// the iterated vectors of all the systems are stacked (locally, with no communication) into a single vector so that the systems
+// are accelerated together as one coupled iteration
+//*******************************************************************|************************************************************//
+void Bucket::fill_anderson_()
+{
+  if (andersondepth_ > 0)
+  {
+    PetscErrorCode perr;
+    std::size_t nlocal = 0;
+    for (SystemBucket_const_it s_it = systems_begin(); 
+                               s_it != systems_end(); s_it++)
+    {
+      if ((*(*s_it).second).fields_size() > 0)
+      {
+        nlocal += (*(*(*(*s_it).second).iteratedfunction()).vector()).local_size();
+      }
+    }
+
+    Vec x;
+    perr = VecCreateMPI((*(*meshes_begin()).second).mpi_comm(), nlocal, PETSC_DETERMINE, &x); 
+    petsc_err(perr);
+    andersonx_.reset( new dolfin::PETScVector(x) );                  // the wrapper takes its own reference to x
+    perr = VecDestroy(&x); petsc_err(perr);
+    andersong_.reset( new dolfin::PETScVector(*andersonx_) );
+
+    anderson_.reset( new AndersonAccelerator(*andersonx_, andersondepth_, relax_) );
+  }
+}
+
 //*******************************************************************|************************************************************//
 // after having filled the system and function buckets loop over them and register their functions with their uflsymbols 
 //*******************************************************************|************************************************************//
@@ -1401,6 +1576,119 @@ void Bucket::solve_at_start_()
   }
 }
 
+//*******************************************************************|************************************************************//
+// store the system functions and the time at the start of a timestep so that it can be rolled back if the timestep is rejected
+//*******************************************************************|************************************************************//
+void Bucket::store_state_()
+{
+  if (!timestep_errortol_)
+  {
+    return;
+  }
+
+  stateoldtime_ = old_time();
+  for (SystemBucket_const_it s_it = systems_begin(); 
+                             s_it != systems_end(); s_it++)
+  {
+    (*(*s_it).second).store_state();
+  }
+}
+
+//*******************************************************************|************************************************************//
+// decide whether to accept the latest timestep based on the convergence of the solvers and an estimate of the time discretization
+// error
+// rejected timesteps have their timestep reduced, accepted ones propose the next timestep using a PI controller:
+//   dt_new = dt*safety*err^(-0.7/k)*err_old^(0.4/k)
+// where k = 2 is the order of the error estimate
+//*******************************************************************|************************************************************//
+bool Bucket::accept_timestep_()
+{
+  if (!timestep_errortol_)
+  {
+    return true;
+  }
+
+  bool failed = iterationsfailed_;
+  for (SystemBucket_const_it s_it = systems_begin(); 
+                             s_it != systems_end(); s_it++)
+  {
+    failed = failed || (*(*s_it).second).failed();
+  }
+
+  double error = -1.0;                                               // negative if we can't estimate the error
+  if (!failed && timestep() > DOLFIN_EPS && oldtimestep_ > DOLFIN_EPS)
+  {
+    for (SystemBucket_const_it s_it = systems_begin(); 
+                               s_it != systems_end(); s_it++)
+    {
+      error = std::max(error, (*(*s_it).second).error_norm(timestep()/oldtimestep_, 
+                                                           *timestep_errortol_, timestep_erroratol_));
+    }
+  }
+
+  if (failed || error > 1.0)
+  {
+    double factor = 0.5;                                             // halve the timestep if something failed to converge
+    if (!failed)
+    {
+      factor = std::min(std::max(0.2, timestep_safety_*std::pow(error, -0.5)), 0.9);
+    }
+    const double new_dt = timestep()*factor;
+
+    timestep_rejections_++;
+    log(WARNING, "Rejecting timestep %d (%s), retrying with timestep %g.", 
+                  timestep_count(), (failed ? "convergence failure" : "error too large"), new_dt);
+    if (!failed)
+    {
+      log(WARNING, "  Timestep error estimate: %g", error);
+    }
+
+    if (timestep_rejections_ > timestep_maxrejections_ || new_dt <= timestep_minimum_)
+    {
+      tf_fail("Timestep rejected.", "Rejections = %d, timestep = %g, minimum timestep = %g.", 
+              timestep_rejections_, new_dt, timestep_minimum_);
+    }
+
+    *(timestep_.second) = new_dt;
+    return false;
+  }
+
+  if (error < 0.0)                                                   // no error estimate so don't propose anything
+  {
+    timestep_errordt_ = HUGE_VAL;
+  }
+  else
+  {
+    error = std::max(error, 1.e-10);
+    const double factor = timestep_safety_*std::pow(error, -0.35)*std::pow(timestep_errorold_, 0.2);
+    timestep_errordt_ = timestep()*std::min(std::max(factor, 0.2), 5.0);
+    timestep_errorold_ = error;
+    log(INFO, "Timestep error estimate: %g, proposed timestep: %g", error, timestep_errordt_);
+  }
+
+  timestep_rejections_ = 0;
+  oldtimestep_ = timestep();
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// roll back a rejected timestep, restoring the times, timestep count and system functions stored at its start
+//*******************************************************************|************************************************************//
+void Bucket::rollback_timestep_()
+{
+  *current_time_ = *old_time_;
+  *old_time_ = stateoldtime_;
+  (*timestep_count_)--;
+
+  for (SystemBucket_const_it s_it = systems_begin(); 
+                             s_it != systems_end(); s_it++)
+  {
+    (*(*s_it).second).restore_state();
+    (*(*s_it).second).reset_failed();
+  }
+  iterationsfailed_ = false;
+}
+
 //*******************************************************************|************************************************************//
 // loop over the ordered systems in the bucket, calling solve on each that has requested a solve in the timeloop (within a nonlinear
 // systems iteration loop)
@@ -1416,11 +1704,30 @@ void Bucket::solve_in_timeloop_()
     log(INFO, "Entering nonlinear systems iteration.");
   }
 
+  for (SystemBucket_const_it s_it = systems_begin();                 // reset the per system solve counts (and record the initial
+                             s_it != systems_end(); s_it++)          // residuals) and work out how many substeps subcycled systems
+  {                                                                  // need
+    (*(*s_it).second).start_iterating();
+    (*(*s_it).second).update_substeps();
+  }
+
+  if (anderson_)
+  {
+    (*anderson_).reset();                                            // forget the history from previous timesteps
+  }
+
   while (!complete_iterating_(aerror0))
   {
     (*iteration_count_)++;                                           // increment iteration counter
 
-    solve(SOLVE_TIMELOOP);                                           // solve all systems in the bucket
+    if (lazysolves_ && rtol_)
+    {
+      solve_lazily_(SOLVE_TIMELOOP, iteration_count() > 1);          // solve the systems that need it (always all of them on the
+    }                                                                // first iteration)
+    else
+    {
+      solve(SOLVE_TIMELOOP);                                         // solve all systems in the bucket
+    }
 
     update_iterated();                                               // apply relaxation
 
@@ -1428,6 +1735,130 @@ void Bucket::solve_in_timeloop_()
   }
 }
 
+//*******************************************************************|************************************************************//
+// solve a system, advancing it in substeps of the timestep if it is subcycled in the timeloop
+// during each substep the timestep and times are those of the substep and the (old and iterated) functions of the systems it
+// depends on are interpolated linearly in time, all of which are restored afterwards (along with the old function of the system)
+//*******************************************************************|************************************************************//
+bool Bucket::solve_system_(SystemBucket_ptr system, const int &location)
+{
+  const int nsubsteps = (*system).substeps();
+  if (location != SOLVE_TIMELOOP || nsubsteps <= 1)
+  {
+    return (*system).solve(location);
+  }
+
+  std::vector< SystemBucket_ptr > dependencies;
+  std::map< const SystemBucket*, std::vector< SystemBucket_ptr > >::const_iterator d_it = 
+                                                  systemdependencies_.find(&(*system));
+  if (d_it != systemdependencies_.end())
+  {
+    dependencies = (*d_it).second;
+  }
+
+  const double dt = timestep();
+  const double oldtime = old_time();
+  const double time = current_time();
+
+  (*system).begin_interpolation();                                   // keep the old function of the system
+  for (std::vector< SystemBucket_ptr >::const_iterator dep_it = dependencies.begin(); 
+                                                       dep_it != dependencies.end(); dep_it++)
+  {
+    (**dep_it).begin_interpolation();
+  }
+
+  *(timestep_.second) = dt/nsubsteps;
+  bool solved = false;
+  for (int j = 0; j < nsubsteps; j++)
+  {
+    if (j > 0)
+    {
+      (*system).advance_substep();
+    }
+
+    *old_time_ = oldtime + j*dt/nsubsteps;
+    *current_time_ = oldtime + (j+1)*dt/nsubsteps;
+
+    for (std::vector< SystemBucket_ptr >::const_iterator dep_it = dependencies.begin(); 
+                                                         dep_it != dependencies.end(); dep_it++)
+    {
+      (**dep_it).interpolate(double(j)/nsubsteps, double(j+1)/nsubsteps);
+    }
+
+    (*system).update_timedependent();
+    (*system).update_nonlinear();
+
+    log(DBG, "  Substep %d of %d for %s, times: %g -> %g", j+1, nsubsteps, 
+                          (*system).name().c_str(), old_time(), current_time());
+
+    solved = (*system).solve(location) || solved;
+  }
+
+  (*system).residual_norm(std::vector<int>(1, location));            // record the residual at the final substep
+
+  *(timestep_.second) = dt;
+  *old_time_ = oldtime;
+  *current_time_ = time;
+
+  for (std::vector< SystemBucket_ptr >::const_iterator dep_it = dependencies.begin(); 
+                                                       dep_it != dependencies.end(); dep_it++)
+  {
+    (**dep_it).end_interpolation();
+  }
+  (*system).end_substeps();
+
+  (*system).update_timedependent();
+  (*system).update_nonlinear();
+
+  return solved;
+}
+
+//*******************************************************************|************************************************************//
+// loop over the ordered systems, solving each one unless (if skip is true) its residual already satisfies the nonlinear systems
+// tolerances and the systems it depends on have changed less than the input change tolerance since it was last solved
+// after each solve the relative change in the system is added to the input change of the systems that depend on it
+//*******************************************************************|************************************************************//
+void Bucket::solve_lazily_(const int &location, const bool skip)
+{
+  for (SystemBucket_const_it s_it = systems_begin(); 
+                             s_it != systems_end(); s_it++)
+  {
+    SystemBucket_ptr system = (*s_it).second;
+
+    if (skip && (*system).solve_count() > 0)
+    {
+      const double rtol = std::max((*rtol_)*(*system).initial_residual_norm(), atol_);
+      if ((*system).last_residual_norm() <= rtol && 
+          (*system).input_change() <= lazychangetol_)
+      {
+        log(INFO, "  Skipping solve of %s (residual norm = %g, input change = %g)", 
+                    (*system).name().c_str(), (*system).last_residual_norm(), (*system).input_change());
+        (*system).set_skipped(true);
+        continue;
+      }
+    }
+
+    (*system).set_skipped(false);
+
+    if (solve_system_(system, location))
+    {
+      (*system).reset_input_change();
+
+      std::map< const SystemBucket*, std::vector< SystemBucket_ptr > >::const_iterator d_it = 
+                                                      systemdependents_.find(&(*system));
+      if (d_it != systemdependents_.end())
+      {
+        const double change = (*system).iterated_change();
+        for (std::vector< SystemBucket_ptr >::const_iterator dep_it = (*d_it).second.begin(); 
+                                                             dep_it != (*d_it).second.end(); dep_it++)
+        {
+          (**dep_it).add_input_change(change);
+        }
+      }
+    }
+  }
+}
+
 //*******************************************************************|************************************************************//
 // return a boolean indicating if the timestep has finished iterating or not
 //*******************************************************************|************************************************************//
@@ -1479,6 +1910,11 @@ bool Bucket::complete_iterating_(const double &aerror0)
       {
         log(WARNING, "Ignoring: Nonlinear system failure.");
       }
+      else if (timestep_errortol_)
+      {
+        log(WARNING, "Recording: Nonlinear system failure.");
+        iterationsfailed_ = true;
+      }
       else
       {
         tf_fail("Nonlinear systems failed to converge.", "Iteration count, relative error or absolute error too high.");
@@ -1490,6 +1926,20 @@ bool Bucket::complete_iterating_(const double &aerror0)
     completed = iteration_count() >= maxits_;
   }
 
+  if (!completed && timestep_errortol_)                              // no point iterating further if a solver has failed as the
+  {                                                                  // timestep will be rejected
+    for (SystemBucket_const_it s_it = systems_begin(); 
+                               s_it != systems_end(); s_it++)
+    {
+      if ((*(*s_it).second).failed())
+      {
+        log(WARNING, "Solver failure in %s, abandoning nonlinear systems iteration.", (*(*s_it).second).name().c_str());
+        completed = true;
+        break;
+      }
+    }
+  }
+
   return completed;
 }
 
@@ -41,7 +41,6 @@ PetscErrorCode buckettools::FormFunction(SNES snes, Vec x, Vec f,
 
   SolverBucket* solver = (*snesctx).solver;                          // retrieve a (standard) pointer to this solver
   SystemBucket* system = (*solver).system();                         // retrieve a (standard) pointer to the parent system of this solver
-  Bucket*       bucket = (*system).bucket();                         // retrieve a (standard) pointer to the parent bucket of this solver
 
   PetscErrorCode perr;                                               // petsc error code
   if ((*solver).monitor_norms())
@@ -68,10 +67,12 @@ PetscErrorCode buckettools::FormFunction(SNES snes, Vec x, Vec f,
 
   (*(*iteratedfunction).vector()) = iteratedvec;                     // update the iterated system bucket function
 
-  (*bucket).update_nonlinear();                                      // update nonlinear coefficients
+  (*solver).update_nonlinear();                                      // update the nonlinear coefficients this solver uses
 
-  dolfin::Assembler assembler;
-  assembler.assemble(rhs, *(*solver).linear_form());
+  double starttime = MPI_Wtime();
+  (*(*solver).assembler()).assemble(rhs, *(*solver).linear_form());  // reuse the persistent solver assembler
+  (*solver).add_assembly_time(MPI_Wtime() - starttime);
+  (*solver).reused_assembler();
   for(uint i = 0; i < bcs.size(); ++i)                               // loop over the bcs
   {
     (*bcs[i]).apply(rhs, (*(*iteratedfunction).vector()));
@@ -128,7 +129,6 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
 
   SolverBucket* solver = (*snesctx).solver;                          // retrieve a (standard) pointer to this solver
   SystemBucket* system = (*solver).system();                         // retrieve a (standard) pointer to the parent system of this solver
-  Bucket*       bucket = (*system).bucket();                         // retrieve a (standard) pointer to the parent bucket of this solver
 
   PetscInt iter;
   perr = SNESGetIterationNumber(snes, &iter); CHKERRQ(perr);
@@ -144,19 +144,22 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
     perr = VecNorm(x,NORM_INFINITY,&norm); CHKERRQ(perr);
     log(dolfin::get_log_level(), "FormJacobian(1): inf-norm x = %g", norm);
 
-    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
-    perr = MatNorm(*A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
-    #else
-    perr = MatNorm(A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
-    #endif
-    log(dolfin::get_log_level(), "FormJacobian(1): Frobenius norm A = %g", norm);
+    if (!(*solver).matrix_free())                                    // can't take the norm of a matrix-free operator
+    {
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+      perr = MatNorm(*A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
+      #else
+      perr = MatNorm(A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
+      #endif
+      log(dolfin::get_log_level(), "FormJacobian(1): Frobenius norm A = %g", norm);
 
-    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
-    perr = MatNorm(*A,NORM_INFINITY,&norm); CHKERRQ(perr);
-    #else
-    perr = MatNorm(A,NORM_INFINITY,&norm); CHKERRQ(perr);
-    #endif
-    log(dolfin::get_log_level(), "FormJacobian(1): inf-norm A = %g", norm);
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+      perr = MatNorm(*A,NORM_INFINITY,&norm); CHKERRQ(perr);
+      #else
+      perr = MatNorm(A,NORM_INFINITY,&norm); CHKERRQ(perr);
+      #endif
+      log(dolfin::get_log_level(), "FormJacobian(1): inf-norm A = %g", norm);
+    }
 
     #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
     perr = MatNorm(*B,NORM_FROBENIUS,&norm); CHKERRQ(perr);
@@ -174,8 +177,6 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
   }
 
   Function_ptr iteratedfunction = (*system).iteratedfunction();      // collect the iterated system bucket function
-  const std::vector< std::shared_ptr<const dolfin::DirichletBC> >& bcs = 
-                                         (*system).bcs();   // get the vector of bcs
   dolfin::PETScVector iteratedvec(x);
   #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
   dolfin::PETScMatrix matrix(*A), matrixpc(*B);
@@ -185,34 +186,50 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
 
   (*(*iteratedfunction).vector()) = iteratedvec;                     // update the iterated system bucket function
 
-  (*bucket).update_nonlinear();                                      // update nonlinear coefficients
+  (*solver).update_nonlinear();                                      // update the nonlinear coefficients this solver uses
 
-  dolfin::SystemAssembler assembler((*solver).bilinear_form(), (*solver).linear_form(),
-                                    bcs);
-  assembler.assemble(matrix);                                        // assemble the matrix from the context bilinear form
-  if ((*solver).ident_zeros())
+  double starttime = MPI_Wtime();
+  if ((*solver).matrix_free())                                       // the jacobian action is matrix-free so just let it know
+  {                                                                  // about the new linearization point
+    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+    perr = MatAssemblyBegin(*A, MAT_FINAL_ASSEMBLY); CHKERRQ(perr);
+    perr = MatAssemblyEnd(*A, MAT_FINAL_ASSEMBLY); CHKERRQ(perr);
+    #else
+    perr = MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY); CHKERRQ(perr);
+    perr = MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY); CHKERRQ(perr);
+    #endif
+  }
+  else if ((*solver).form_changed((*solver).bilinear_form()))        // only reassemble if the coefficients have changed
   {
-    matrix.ident_zeros();
+    (*(*solver).system_assembler()).assemble(matrix);                // assemble the matrix from the context bilinear form
+    if ((*solver).ident_zeros())
+    {
+      matrix.ident_zeros();
+    }
   }
 
   if ((*solver).bilinearpc_form())                                   // do we have a different bilinear pc form associated?
   {
-    dolfin::SystemAssembler assemblerpc((*solver).bilinearpc_form(), (*solver).linear_form(),
-                                      bcs);
-    assemblerpc.assemble(matrixpc);
-    if ((*solver).ident_zeros_pc())
+    if ((*solver).form_changed((*solver).bilinearpc_form()))
     {
-      matrixpc.ident_zeros();
+      (*(*solver).system_assembler_pc()).assemble(matrixpc);
+      if ((*solver).ident_zeros_pc())
+      {
+        matrixpc.ident_zeros();
+      }
     }
   }
 
   for (Form_const_it f_it = (*solver).solverforms_begin();           // update any solver forms/matrices/submatrices as well
                      f_it != (*solver).solverforms_end(); f_it++)    // - these will already be attached to the appropriate
   {                                                                  // ksps so be careful just to update their pointers
+    if (!(*solver).form_changed((*f_it).second))
+    {
+      continue;
+    }
+
     PETScMatrix_ptr solvermatrix = (*solver).fetch_solvermatrix((*f_it).first);
-    dolfin::SystemAssembler assemblerform((*f_it).second, (*solver).linear_form(),
-                                      bcs);
-    assemblerform.assemble(*solvermatrix);
+    (*(*solver).fetch_solversystemassembler((*f_it).first)).assemble(*solvermatrix);
     if((*solver).solverident_zeros((*f_it).first))
     {
       (*solvermatrix).ident_zeros();
@@ -224,6 +241,8 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
     CHKERRQ(perr);
 
   }
+  (*solver).add_assembly_time(MPI_Wtime() - starttime);
+  (*solver).reused_system_assemblers();
 
   #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
   *flag = SAME_NONZERO_PATTERN;                                      // both matrices are assumed to have the same sparsity
@@ -239,19 +258,22 @@ PetscErrorCode buckettools::FormJacobian(SNES snes, Vec x, Mat A,
     perr = VecNorm(x,NORM_INFINITY,&norm); CHKERRQ(perr);
     log(dolfin::get_log_level(), "FormJacobian(2): inf-norm x = %g", norm);
 
-    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
-    perr = MatNorm(*A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
-    #else
-    perr = MatNorm(A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
-    #endif
-    log(dolfin::get_log_level(), "FormJacobian(2): Frobenius norm A = %g", norm);
+    if (!(*solver).matrix_free())                                    // can't take the norm of a matrix-free operator
+    {
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+      perr = MatNorm(*A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
+      #else
+      perr = MatNorm(A,NORM_FROBENIUS,&norm); CHKERRQ(perr);
+      #endif
+      log(dolfin::get_log_level(), "FormJacobian(2): Frobenius norm A = %g", norm);
 
-    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
-    perr = MatNorm(*A,NORM_INFINITY,&norm); CHKERRQ(perr);
-    #else
-    perr = MatNorm(A,NORM_INFINITY,&norm); CHKERRQ(perr);
-    #endif
-    log(dolfin::get_log_level(), "FormJacobian(2): inf-norm A = %g", norm);
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+      perr = MatNorm(*A,NORM_INFINITY,&norm); CHKERRQ(perr);
+      #else
+      perr = MatNorm(A,NORM_INFINITY,&norm); CHKERRQ(perr);
+      #endif
+      log(dolfin::get_log_level(), "FormJacobian(2): inf-norm A = %g", norm);
+    }
 
     #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
     perr = MatNorm(*B,NORM_FROBENIUS,&norm); CHKERRQ(perr);
@@ -39,7 +39,7 @@ ConvergenceFile::ConvergenceFile(const std::string &name,
                                  const Bucket *bucket,
                                  const std::string &systemname, 
                                  const std::string &solvername) :
-                                      DiagnosticsFile(name, comm, bucket),
+                                      DiagnosticsFile(name, comm, bucket, (*bucket).binary_diagnostics()),
                                       systemname_(systemname),
                                       solvername_(solvername)
 {
@@ -60,7 +60,7 @@ ConvergenceFile::~ConvergenceFile()
 void ConvergenceFile::write_header()
 {
   header_open_();
-  header_constants_();                                               // write constant tags
+  header_constants_(binary_);                                        // write constant tags
   header_timestep_();                                                // write tags for the timesteps
   header_iteration_();                                               // write tags for the iterations
   header_bucket_();                                                  // write tags for the actual bucket variables - fields etc.
@@ -89,6 +89,9 @@ void ConvergenceFile::header_iteration_()
   
   tag_("NonlinearSystemsIteration", "value");                        // the nonlinear systems iteration
   tag_("NonlinearIteration", "value");                               // the nonlinear solver iteration
+  tag_("AssemblyWallTime", "value");                                 // the wall time spent assembling in this solve
+  tag_("AssemblySetupSaved", "value");                               // the wall time saved by reusing the assemblers in this solve
+  tag_("MatrixAssemblies", "value");                                 // the number of matrices reassembled in this solve
   
 }
 
@@ -201,6 +204,9 @@ void ConvergenceFile::data_iteration_()
   
   data_((*bucket_).iteration_count());
   data_((*sol_ptr).iteration_count());
+  data_((*sol_ptr).assembly_time());
+  data_((*sol_ptr).assembly_setup_saved());
+  data_((*sol_ptr).matrix_assemblies());
 }
 
 //*******************************************************************|************************************************************//
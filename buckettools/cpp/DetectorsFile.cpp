@@ -25,6 +25,7 @@
 #include "Logger.h"
 #include <cstdio>
 #include <string>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -59,8 +60,10 @@ DetectorsFile::DetectorsFile(const std::string name,
   }
 
   mpiwritecount_ = 0;                                                // incremented at every data dump
+  mpiviewcount_ = 0;
+  mpiwritecolumn_ = 0;
 #ifdef HAS_MPI
-  mpiwritelocation_ = 0;
+  mpihaveview_ = false;
 #endif
 
 }
@@ -73,7 +76,13 @@ DetectorsFile::~DetectorsFile()
   if (dolfin::MPI::size(mpicomm_)>1)
   {
 #ifdef HAS_MPI                                                       // presumably true as size return > 1
-    int mpierr = MPI_File_close(&mpifile_);
+    int mpierr;
+    if (mpihaveview_)
+    {
+      mpierr = MPI_Type_free(&mpifiletype_);
+      mpi_err(mpierr);
+    }
+    mpierr = MPI_File_close(&mpifile_);
     if (mpierr!=MPI_SUCCESS)
     {
       tf_err("MPI error closing MPI_File.", "MPI error: %d", mpierr);
@@ -101,20 +110,18 @@ void DetectorsFile::write_header()
 void DetectorsFile::write_data()
 {
   
+  mpiwritecolumn_ = 0;
+  rowcolumns_.clear();
+  rowvalues_.clear();
+
   data_timestep_();
   data_bucket_();
   
   if (dolfin::MPI::size(mpicomm_)>1)
   {
+    assert(mpiwritecolumn_==ncolumns_);                              // quick sanity check...
+    data_row_();
     mpiwritecount_++;
-    // quick sanity check...
-#ifdef HAS_MPI
-    int mpierr;
-    MPI_Aint lb, doublesize;
-    mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &lb, &doublesize);
-    mpi_err(mpierr);
-    assert(mpiwritelocation_==mpiwritecount_*ncolumns_*doublesize);
-#endif
   }
   else
   {
@@ -135,58 +142,12 @@ void DetectorsFile::data_timestep_()
   }
   else
   {
-#ifdef HAS_MPI
-    int mpierr;
-    double value;
-
-    MPI_Aint lb, doublesize;
-    mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &lb, &doublesize);
-    mpi_err(mpierr);
-
-    value = (double)(*bucket_).timestep_count();                     // we recast this to make it easier to count columns
-    if (dolfin::MPI::rank(mpicomm_)==0)
-    {
-      mpierr = MPI_File_write_at(mpifile_, mpiwritelocation_, 
-                                 &value, 1, 
-                                 MPI_DOUBLE_PRECISION, 
-                                 MPI_STATUS_IGNORE);
-      mpi_err(mpierr);
-    }
-    mpiwritelocation_ += doublesize;
-
-    value = (*bucket_).current_time();
-    if (dolfin::MPI::rank(mpicomm_)==0)
-    {
-      mpierr = MPI_File_write_at(mpifile_, mpiwritelocation_, 
-                                 &value, 1, 
-                                 MPI_DOUBLE_PRECISION, 
-                                 MPI_STATUS_IGNORE);
-      mpi_err(mpierr);
-    }
-    mpiwritelocation_ += doublesize;
+    const bool rank0 = dolfin::MPI::rank(mpicomm_)==0;               // only rank 0 writes these
 
-    value = (*bucket_).elapsed_walltime();
-    if (dolfin::MPI::rank(mpicomm_)==0)
-    {
-      mpierr = MPI_File_write_at(mpifile_, mpiwritelocation_, 
-                                 &value, 1, 
-                                 MPI_DOUBLE_PRECISION, 
-                                 MPI_STATUS_IGNORE);
-      mpi_err(mpierr);
-    }
-    mpiwritelocation_ += doublesize;
-
-    value = (*bucket_).timestep();
-    if (dolfin::MPI::rank(mpicomm_)==0)
-    {
-      mpierr = MPI_File_write_at(mpifile_, mpiwritelocation_, 
-                                 &value, 1, 
-                                 MPI_DOUBLE_PRECISION, 
-                                 MPI_STATUS_IGNORE);
-      mpi_err(mpierr);
-    }
-    mpiwritelocation_ += doublesize;
-#endif
+    data_value_((double)(*bucket_).timestep_count(), rank0);         // we recast this to make it easier to count columns
+    data_value_((*bucket_).current_time(), rank0);
+    data_value_((*bucket_).elapsed_walltime(), rank0);
+    data_value_((*bucket_).timestep(), rank0);
   }
   
 }
@@ -334,12 +295,6 @@ void DetectorsFile::data_detector_(const GenericDetectors_ptr d_ptr)
   const bool parallel = dolfin::MPI::size(mpicomm_)>1;
   const bool rank0 = dolfin::MPI::rank(mpicomm_)==0;                 // since all processors know the positions only rank 0 writes
                                                                      // perhaps all processes should write?
-#ifdef HAS_MPI
-  int mpierr;
-  MPI_Aint lb, doublesize;
-  mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &lb, &doublesize);
-  mpi_err(mpierr);
-#endif
 
   for (uint dim = 0; dim<(*d_ptr).dim(); dim++)
   {
@@ -349,17 +304,7 @@ void DetectorsFile::data_detector_(const GenericDetectors_ptr d_ptr)
     {   
       if (parallel)
       {
-#ifdef HAS_MPI
-        if(rank0)
-        {
-          mpierr = MPI_File_write_at(mpifile_, mpiwritelocation_, 
-                                     &(**pos)[dim], 1, 
-                                     MPI_DOUBLE_PRECISION, 
-                                     MPI_STATUS_IGNORE);
-          mpi_err(mpierr);
-        }
-        mpiwritelocation_ += doublesize;
-#endif
+        data_value_((**pos)[dim], rank0);
       }
       else
       {
@@ -378,58 +323,132 @@ void DetectorsFile::data_func_(const FunctionBucket_ptr f_ptr)
   
   const bool parallel = dolfin::MPI::size(mpicomm_)>1;
   
-#ifdef HAS_MPI
-  int mpierr;
-  MPI_Aint lb, doublesize;
-  mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &lb, &doublesize);
-  mpi_err(mpierr);
-#endif
-
   for ( std::vector<GenericDetectors_ptr>::const_iterator
                                          d_it = detectors_.begin();
                                          d_it != detectors_.end(); 
                                          d_it++)
   {
-    std::vector< Array_double_ptr > values;
-    
     GenericFunction_ptr func = (*f_ptr).iteratedfunction();
 
-    (*(*d_it)).eval(values, *func, (*(*f_ptr).system()).mesh());
-    std::vector< int > ids = (*(*d_it)).detector_ids((*(*f_ptr).system()).mesh());
-    assert(values.size()==ids.size());
+    (*(*d_it)).eval(values_, *func, (*(*f_ptr).system()).mesh());   // values_[dim*nids + i] is component dim at detector ids[i]
+    const std::vector< int > &ids = (*(*d_it)).detector_ids((*(*f_ptr).system()).mesh());
+    const uint nids = ids.size();
+    assert(values_.size()==(*func).value_size()*nids);
     
-    for (uint dim = 0; dim < (*func).value_size(); dim++)
+    if (parallel)
     {
-      for(uint i=0; i < values.size(); i++)
+      for (uint dim = 0; dim < (*func).value_size(); dim++)          // each process only adds the detectors it owns
       {
-        if (parallel)
+        for(uint i=0; i < nids; i++)
         {
-#ifdef HAS_MPI
-          MPI_Offset location = mpiwritelocation_ 
-                              + (dim*((*(*d_it)).size()) 
-                                 + ids[i])*doublesize;
-          mpierr = MPI_File_write_at(mpifile_, location, 
-                                     &(*values[i])[dim], 1, 
-                                     MPI_DOUBLE_PRECISION, 
-                                     MPI_STATUS_IGNORE);
-          mpi_err(mpierr);
-#endif
+          rowcolumns_.push_back(mpiwritecolumn_ + dim*(*(*d_it)).size() + ids[i]);
+          rowvalues_.push_back(values_[dim*nids + i]);
         }
-        else
+      }
+      mpiwritecolumn_ += (*func).value_size()*(*(*d_it)).size();
+    }
+    else
+    {
+      for (uint dim = 0; dim < (*func).value_size(); dim++)
+      {
+        for(uint i=0; i < nids; i++)
         {
-          data_((*values[i])[dim]);
+          data_(values_[dim*nids + i]);
         }
       }
     }
 
-    if (parallel)
-    {
+  }
+  
+}
+
+//*******************************************************************|************************************************************//
+// add a value to the next column of the row being assembled on this process (if write is true, otherwise just skip the column)
+//*******************************************************************|************************************************************//
+void DetectorsFile::data_value_(const double &value, const bool &write)
+{
+  if (write)
+  {
+    rowcolumns_.push_back(mpiwritecolumn_);
+    rowvalues_.push_back(value);
+  }
+  mpiwritecolumn_++;
+}
+
+//*******************************************************************|************************************************************//
+// write the row assembled on this process to the file with a single collective write
+// the columns each process writes are described by a file view (an indexed datatype tiled every row) that is only rebuilt if the
+// columns owned by any process change
+//*******************************************************************|************************************************************//
+void DetectorsFile::data_row_()
+{
 #ifdef HAS_MPI
-      mpiwritelocation_ += (*func).value_size()*(*(*d_it)).size()*doublesize;
-#endif
+  int mpierr;
+
+  const bool changed = !mpihaveview_ || (rowcolumns_ != viewcolumns_);
+  if (dolfin::MPI::sum(mpicomm_, (int)changed) > 0)                  // setting the view is collective so all processes must agree
+  {
+    viewcolumns_ = rowcolumns_;
+
+    std::vector< std::pair< int, std::size_t > > sorted(viewcolumns_.size());
+    for (std::size_t i = 0; i < sorted.size(); i++)
+    {
+      sorted[i] = std::make_pair(viewcolumns_[i], i);
     }
+    std::sort(sorted.begin(), sorted.end());                         // the view must have monotonically increasing displacements
 
+    vieworder_.resize(sorted.size());
+    std::vector< int > displacements(sorted.size());
+    for (std::size_t i = 0; i < sorted.size(); i++)
+    {
+      displacements[i] = sorted[i].first;
+      vieworder_[i] = sorted[i].second;
+    }
+
+    MPI_Aint lb, doublesize;
+    mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &lb, &doublesize);
+    mpi_err(mpierr);
+
+    if (mpihaveview_)
+    {
+      mpierr = MPI_Type_free(&mpifiletype_);
+      mpi_err(mpierr);
+    }
+
+    MPI_Datatype columntype;
+    mpierr = MPI_Type_create_indexed_block(displacements.size(), 1, 
+                                           displacements.data(),
+                                           MPI_DOUBLE_PRECISION, &columntype);
+    mpi_err(mpierr);
+    mpierr = MPI_Type_create_resized(columntype, 0, ncolumns_*doublesize, // tile the view every row
+                                     &mpifiletype_);
+    mpi_err(mpierr);
+    mpierr = MPI_Type_commit(&mpifiletype_);
+    mpi_err(mpierr);
+    mpierr = MPI_Type_free(&columntype);
+    mpi_err(mpierr);
+
+    mpierr = MPI_File_set_view(mpifile_, 
+                               (MPI_Offset)mpiwritecount_*ncolumns_*doublesize,
+                               MPI_DOUBLE_PRECISION, mpifiletype_, 
+                               (char*)"native", MPI_INFO_NULL);
+    mpi_err(mpierr);
+
+    mpihaveview_ = true;
+    mpiviewcount_ = mpiwritecount_;
   }
-  
+
+  sendvalues_.resize(vieworder_.size());
+  for (std::size_t i = 0; i < vieworder_.size(); i++)
+  {
+    sendvalues_[i] = rowvalues_[vieworder_[i]];
+  }
+
+  MPI_Offset offset = (MPI_Offset)(mpiwritecount_-mpiviewcount_)*sendvalues_.size();
+  mpierr = MPI_File_write_at_all(mpifile_, offset,                   // offset in the view (counted in values this process writes)
+                                 sendvalues_.data(), sendvalues_.size(),
+                                 MPI_DOUBLE_PRECISION, MPI_STATUS_IGNORE);
+  mpi_err(mpierr);
+#endif
 }
 
@@ -25,6 +25,7 @@
 #include "Usage.h"
 #include <cstdio>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -37,12 +38,19 @@ using namespace buckettools;
 //*******************************************************************|************************************************************//
 DiagnosticsFile::DiagnosticsFile(const std::string &name, 
                                  const MPI_Comm &comm,
-                                 const Bucket *bucket) : 
-                                 name_(name), mpicomm_(comm), bucket_(bucket), ncolumns_(0)
+                                 const Bucket *bucket,
+                                 const bool &binary) : 
+                                 binary_(binary), name_(name), mpicomm_(comm), bucket_(bucket), 
+                                 ncolumns_(0)
 {
   if (dolfin::MPI::rank(mpicomm_)==0)
   {
     file_.open((char*)name.c_str());                                 // open the file_ member
+    if (binary_)
+    {
+      datfile_.open((char*)(name_+".dat").c_str(),                   // open the binary data file (truncating any previous one)
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+    }
   }
 }
 
@@ -119,7 +127,8 @@ void DiagnosticsFile::header_constants_(const bool &binary)
 
     int doublesize, intsize;
 #ifdef HAS_MPI
-    // currently binary output is only used for parallel detectors so the mpi definition should be used
+    // parallel detectors write their binary output through mpi so the mpi definition should be used
+    // (for the rows written from rank 0 by data_binary_ this matches sizeof(double))
     int mpierr;
     MPI_Aint doublelb, intlb, mpidoublesize, mpiintsize;
     mpierr = MPI_Type_get_extent(MPI_DOUBLE_PRECISION, &doublelb, &mpidoublesize);
@@ -220,7 +229,14 @@ void DiagnosticsFile::data_endlineflush_()
 {
   if (dolfin::MPI::rank(mpicomm_)==0)
   {
-    file_ << std::endl << std::flush;                               // flush the buffer
+    if (binary_)
+    {
+      datfile_ << std::flush;                                        // rows are fixed width so just flush the buffer
+    }
+    else
+    {
+      file_ << std::endl << std::flush;                              // flush the buffer
+    }
   }
 }
 
@@ -231,18 +247,11 @@ void DiagnosticsFile::data_timestep_()
 {
   
   double walltime = (*bucket_).elapsed_walltime();
-  if (dolfin::MPI::rank(mpicomm_)==0)
-  {
-    file_.setf(std::ios::scientific);
-    file_.precision(10);
-    
-    file_ << (*bucket_).timestep_count() << " ";  
-    file_ << (*bucket_).current_time() << " ";
-    file_ << walltime << " ";
-    file_ << (*bucket_).timestep() << " ";
-    
-    file_.unsetf(std::ios::scientific);
-  }
+
+  data_((*bucket_).timestep_count());
+  data_((*bucket_).current_time());
+  data_(walltime);
+  data_((*bucket_).timestep());
   
 }
 
@@ -251,7 +260,12 @@ void DiagnosticsFile::data_timestep_()
 //*******************************************************************|************************************************************//
 void DiagnosticsFile::data_(const int &value)
 {
-  if (dolfin::MPI::rank(mpicomm_)==0)
+  if (binary_)
+  {
+    const double dvalue = (double) value;                            // binary rows are all doubles
+    data_binary_(&dvalue, 1);
+  }
+  else if (dolfin::MPI::rank(mpicomm_)==0)
   {
     file_ << value << " ";
   }
@@ -262,7 +276,11 @@ void DiagnosticsFile::data_(const int &value)
 //*******************************************************************|************************************************************//
 void DiagnosticsFile::data_(const double &value)
 {
-  if (dolfin::MPI::rank(mpicomm_)==0)
+  if (binary_)
+  {
+    data_binary_(&value, 1);
+  }
+  else if (dolfin::MPI::rank(mpicomm_)==0)
   {
     file_.setf(std::ios::scientific);
     file_.precision(10);
@@ -276,7 +294,14 @@ void DiagnosticsFile::data_(const double &value)
 //*******************************************************************|************************************************************//
 void DiagnosticsFile::data_(const std::vector<double> &values)
 {
-  if (dolfin::MPI::rank(mpicomm_)==0)
+  if (binary_)
+  {
+    if (values.size() > 0)
+    {
+      data_binary_(&values[0], values.size());
+    }
+  }
+  else if (dolfin::MPI::rank(mpicomm_)==0)
   {
     file_.setf(std::ios::scientific);
     file_.precision(10);
@@ -288,6 +313,34 @@ void DiagnosticsFile::data_(const std::vector<double> &values)
   }
 }
 
+//*******************************************************************|************************************************************//
+// write an array of doubles to the binary data file in little-endian byte order (swapping the bytes on big-endian hosts)
+//*******************************************************************|************************************************************//
+void DiagnosticsFile::data_binary_(const double *values, const uint &nvalues)
+{
+  if (dolfin::MPI::rank(mpicomm_)==0)
+  {
+    const uint16_t endiantest = 1;
+    if (*((const char*) &endiantest) == 1)                           // little-endian host so write the values directly
+    {
+      datfile_.write((const char*) values, nvalues*sizeof(double));
+    }
+    else
+    {
+      char bytes[sizeof(double)];
+      for (uint i = 0; i < nvalues; i++)
+      {
+        const char *value = (const char*) &values[i];
+        for (uint j = 0; j < sizeof(double); j++)
+        {
+          bytes[j] = value[sizeof(double)-1-j];
+        }
+        datfile_.write(bytes, sizeof(double));
+      }
+    }
+  }
+}
+
 //*******************************************************************|************************************************************//
 // close the file_ (if open)
 //*******************************************************************|************************************************************//
@@ -299,6 +352,10 @@ void DiagnosticsFile::close()
     {
       file_.close();                                                 // close the file_ member
     }
+    if (datfile_.is_open())
+    {
+      datfile_.close();                                              // close the binary data file
+    }
   }
 }
 
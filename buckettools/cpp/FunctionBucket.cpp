@@ -26,16 +26,21 @@
 #include "BucketDolfinBase.h"
 #include "DolfinPETScBase.h"
 #include "BucketPETScBase.h"
+#include "PythonExpression.h"
+#include "RegionsExpression.h"
+#include "SemiLagrangianExpression.h"
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
+#include <cmath>
 
 using namespace buckettools;
 
 //*******************************************************************|************************************************************//
 // default constructor
 //*******************************************************************|************************************************************//
-FunctionBucket::FunctionBucket()
+FunctionBucket::FunctionBucket() : coefficienttimeonly_(false), 
+                                   coefficienttime_(-HUGE_VAL)
 {
                                                                      // do nothing
 }
@@ -43,7 +48,9 @@ FunctionBucket::FunctionBucket()
 //*******************************************************************|************************************************************//
 // specific constructor
 //*******************************************************************|************************************************************//
-FunctionBucket::FunctionBucket(SystemBucket* system) : system_(system)
+FunctionBucket::FunctionBucket(SystemBucket* system) : system_(system), 
+                                                       coefficienttimeonly_(false), 
+                                                       coefficienttime_(-HUGE_VAL)
 {
                                                                      // do nothing
 }
@@ -443,7 +450,7 @@ void FunctionBucket::apply_ic(const std::string &function_type)
 
     if (icexpression_)
     {
-      (*tmpfunction).interpolate(*icexpression_);
+      interpolate_(*tmpfunction, *icexpression_);
     }
     else if(!icfilename_.empty())
     {
@@ -480,7 +487,8 @@ void FunctionBucket::refresh(const bool force)
   {
     if (coefficientfunction_)
     {
-      (*std::dynamic_pointer_cast< dolfin::Function >(function_)).interpolate(*coefficientfunction_);
+      interpolate_(*std::dynamic_pointer_cast< dolfin::Function >(function_), *coefficientfunction_);
+      coefficienttime_ = (*(*system()).bucket()).current_time();
     }
     if (constantfunctional_)
     {
@@ -526,12 +534,20 @@ void FunctionBucket::resetcalculated()
 
 //*******************************************************************|************************************************************//
 // update the potentially time dependent functions
+// (coefficients that only depend on position and time are only reinterpolated if the time has changed since they were last
+// interpolated)
 //*******************************************************************|************************************************************//
 void FunctionBucket::update_timedependent()
 {
   if (coefficientfunction_)
   {
-    (*std::dynamic_pointer_cast< dolfin::Function >(function_)).interpolate(*coefficientfunction_);
+    const double time = (*(*system()).bucket()).current_time();
+    if (coefficienttimeonly_ && time == coefficienttime_)
+    {
+      return;
+    }
+    interpolate_(*std::dynamic_pointer_cast< dolfin::Function >(function_), *coefficientfunction_);
+    coefficienttime_ = time;
   }
 }
 
@@ -588,16 +604,17 @@ void FunctionBucket::postprocess_values()
     double value = 0.0;
     if (zeropoints_[i])
     {
-      std::vector< Array_double_ptr > values;
+      std::vector< double > values;
       (*zeropoints_[i]).eval(values, *function(), (*system_).mesh());
+      const std::size_t nlvals = values.size()/(*function()).value_size();
       double lvalue = 0.0;
-      if (values.size()>0)
+      if (nlvals>0)
       {
-        assert(values.size()==1);
-        lvalue = (*values[0])[i];
+        assert(nlvals==1);
+        lvalue = values[i];                                          // component i at the only detector
       }
       std::size_t nvals = dolfin::MPI::sum((*(*system_).mesh()).mpi_comm(),  // we calculate this just in case more than 1 process
-                                   values.size());                   // found the same value
+                                   nlvals);                          // found the same value
       assert(nvals>0);
       value = dolfin::MPI::sum((*(*system_).mesh()).mpi_comm(),
                                lvalue)/nvals;
@@ -1045,3 +1062,31 @@ void FunctionBucket::checkpoint_options_()
   tf_err("Failed to find virtual function checkpoint_options_.", "Need to implement a checkpointing method.");
 }
 
+//*******************************************************************|************************************************************//
+// interpolate an expression into a function, using the batched interpolation of vectorized python expressions and semi-lagrangian
+// expressions, and the region by region interpolation of region expressions, where possible
+//*******************************************************************|************************************************************//
+void FunctionBucket::interpolate_(dolfin::Function &function, 
+                                  const dolfin::Expression &expression) const
+{
+  const PythonExpression *pyexpression = dynamic_cast< const PythonExpression* >(&expression);
+  const SemiLagrangianExpression *slexpression = dynamic_cast< const SemiLagrangianExpression* >(&expression);
+  const RegionsExpression *regionsexpression = dynamic_cast< const RegionsExpression* >(&expression);
+  if (pyexpression)
+  {
+    (*pyexpression).interpolate(function);
+  }
+  else if (regionsexpression)
+  {
+    (*regionsexpression).interpolate(function);
+  }
+  else if (slexpression)
+  {
+    (*slexpression).interpolate(function);
+  }
+  else
+  {
+    function.interpolate(expression);
+  }
+}
+
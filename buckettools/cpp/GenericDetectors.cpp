@@ -20,9 +20,11 @@
 
 
 #include "GenericDetectors.h"
+#include "PointLocator.h"
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
+#include <algorithm>
 
 using namespace buckettools;
 
@@ -55,34 +57,32 @@ GenericDetectors::~GenericDetectors()
 }
   
 //*******************************************************************|************************************************************//
-// base eval implementation - evaluates a function at the detector positions and returns a vector of arrays of values
+// base eval implementation - evaluates a function at the detector positions owned by this process and returns their values in a
+// single buffer, component by component, so that values[dim*n + i] is component dim at the ith owned detector (n owned detectors)
+// (values is resized as necessary so reusing the same buffer between calls avoids any allocations)
 //*******************************************************************|************************************************************//
-void GenericDetectors::eval(std::vector< Array_double_ptr > &values,
+void GenericDetectors::eval(std::vector< double > &values,
                             const dolfin::GenericFunction &function,
                             Mesh_ptr mesh)
 {
-  Array_double_ptr 
-            value(new dolfin::Array<double>(function.value_size())); // set up a pointer to be reset later to contain the
-  
-  assert(values.empty());                                            // check the values are empty
+  const std::vector< int > &detectorids = detector_ids(mesh);        // evaluates the ownership if necessary
+  const std::vector< ufc::cell > &ufccells = ufc_cells_[mesh];
+  assert(ufccells.size()==detectorids.size());
 
-  int cellid, detectorid;
-  
-  std::vector< int > cellids = cell_ids(mesh);
-  std::vector< int > detectorids = detector_ids(mesh);
+  const std::size_t ndetectors = detectorids.size();
+  const std::size_t valuesize = function.value_size();
+  values.resize(valuesize*ndetectors);
 
-  for (uint i = 0; i<detectorids.size(); i++)                        // loop over the detectors owned by this process
+  point_values_.resize(valuesize);
+  dolfin::Array<double> value(valuesize, point_values_.data());      // wrap the work array (no allocation)
+
+  for (uint i = 0; i<ndetectors; i++)                                // loop over the detectors owned by this process
   {
-    value.reset(new dolfin::Array<double>(function.value_size()));   // reset the value
-
-    cellid = cellids[i];
-    detectorid = detectorids[i];
-    
-    const dolfin::Cell cell(*mesh, cellid);
-    ufc::cell ufc_cell;
-    cell.get_cell_data(ufc_cell);
-    function.eval(*value, *positions_[detectorid], ufc_cell);        // use the dolfin eval to evaluate the function
-    values.push_back(value);                                         // record the value
+    function.eval(value, *positions_[detectorids[i]], ufccells[i]);  // use the dolfin eval to evaluate the function
+    for (uint dim = 0; dim<valuesize; dim++)
+    {
+      values[dim*ndetectors + i] = point_values_[dim];               // record the value
+    }
   }
 
 }
@@ -103,64 +103,81 @@ void GenericDetectors::eval_ownership(Mesh_ptr mesh)
   {
 
     std::vector< int > cellids, detectorids;
-    std::vector<unsigned int> ids;
-    double* pos;
-    uint dim;
-    bool id_not_found = false;
 
     std::size_t cell_ghost_offset = (*mesh).topology().ghost_offset((*mesh).topology().dim());
 
-    for (uint i = 0; i<positions_.size(); i++)                         // loop over the detector positions
+    std::vector< double > points(positions_.size()*meshdim_);       // gather the detector positions (point major)
+    for (uint i = 0; i<positions_.size(); i++)
     {
-      pos = (*positions_[i]).data(); 
-      dim = (*positions_[i]).size();
-      const dolfin::Point point(dim, pos);
-      ids = (*(*mesh).bounding_box_tree()).compute_entity_collisions(point);
-      if (ids.size() == 0)
-      {
-        id_not_found = true;
-      }
-      else if (ids[0] < cell_ghost_offset)
+      assert((*positions_[i]).size()==meshdim_);
+      std::copy((*positions_[i]).data(), (*positions_[i]).data()+meshdim_, &points[i*meshdim_]);
+    }
+
+    std::vector< int > ids;                                          // locate them all together (rejecting those outside this
+    PointLocator locator(mesh);                                      // partition and walking between the rest)
+    locator.locate(points, ids);
+
+    for (uint i = 0; i<positions_.size(); i++)                       // keep the detectors in the cells owned by this process
+    {
+      if (ids[i] >= 0 && (std::size_t)ids[i] < cell_ghost_offset)
       {
-        cellids.push_back(ids[0]);
+        cellids.push_back(ids[i]);
         detectorids.push_back(i);
       }
     }
 
-    if (dolfin::MPI::size((*mesh).mpi_comm())>1)
+    std::size_t found_detectors = detectorids.size();                // check they were all found with a single reduction
+    std::size_t global_number_detectors = dolfin::MPI::sum((*mesh).mpi_comm(), found_detectors);
+    if (global_number_detectors < number_detectors_)
     {
-      std::size_t found_detectors = detectorids.size();
-      std::size_t global_number_detectors = dolfin::MPI::sum((*mesh).mpi_comm(), found_detectors);
-      if (global_number_detectors < number_detectors_)
-      {
-        tf_err("Unable to find a cell for (a) detector(s) in the mesh.", "Detectors name: %s. Found %d out of %d detectors.", 
-               name().c_str(), global_number_detectors, number_detectors_);
-      }
-      if (global_number_detectors > number_detectors_)
-      {
-        tf_warn("More than one process found the same detector.",  "Detectors name %s. Found %d out of %d detectors.", 
-                name().c_str(), global_number_detectors, number_detectors_);
-      }
+      tf_err("Unable to find a cell for (a) detector(s) in the mesh.", "Detectors name: %s. Found %d out of %d detectors.", 
+             name().c_str(), global_number_detectors, number_detectors_);
     }
-    else
+    if (global_number_detectors > number_detectors_)
     {
-      if (id_not_found)
-      {
-        tf_err("Unable to find a cell for (a) detector(s) in the mesh.", "Detectors name: %s. Found %d out of %d detectors.", 
-               name().c_str(), detectorids.size(), number_detectors_);
-      }
+      tf_warn("More than one process found the same detector.",  "Detectors name %s. Found %d out of %d detectors.", 
+              name().c_str(), global_number_detectors, number_detectors_);
     }
 
-    cell_ids_[mesh] = cellids;
-    detector_ids_[mesh] = detectorids;
+    set_ownership_(mesh, cellids, detectorids);
+  }
+
+}
+
+//*******************************************************************|************************************************************//
+// move the detectors - by default detectors are fixed in space so this does nothing
+//*******************************************************************|************************************************************//
+void GenericDetectors::advect()
+{
+                                                                     // do nothing
+}
+
+//*******************************************************************|************************************************************//
+// record the cells and detectors owned by this process on the given mesh, caching the cell data of the owned detectors so that it
+// doesn't have to be rebuilt every time they are evaluated
+//*******************************************************************|************************************************************//
+void GenericDetectors::set_ownership_(Mesh_ptr mesh,
+                                      const std::vector< int > &cellids,
+                                      const std::vector< int > &detectorids)
+{
+  assert(cellids.size()==detectorids.size());
+
+  std::vector< ufc::cell > &ufccells = ufc_cells_[mesh];
+  ufccells.resize(cellids.size());
+  for (uint i = 0; i<cellids.size(); i++)
+  {
+    const dolfin::Cell cell(*mesh, cellids[i]);
+    cell.get_cell_data(ufccells[i]);
   }
 
+  cell_ids_[mesh] = cellids;
+  detector_ids_[mesh] = detectorids;
 }
 
 //*******************************************************************|************************************************************//
 // return a vector of the cell ids (evaluating if necessary)
 //*******************************************************************|************************************************************//
-const std::vector<int> GenericDetectors::cell_ids(Mesh_ptr mesh)
+const std::vector<int>& GenericDetectors::cell_ids(Mesh_ptr mesh)
 {
   std::map< Mesh_ptr, std::vector< int > >::const_iterator c_it = cell_ids_.find(mesh);
   const bool have_cells = ( c_it != cell_ids_.end() );
@@ -178,7 +195,7 @@ const std::vector<int> GenericDetectors::cell_ids(Mesh_ptr mesh)
 //*******************************************************************|************************************************************//
 // return a vector of the detector ids owned by this process (evaluating if necessary)
 //*******************************************************************|************************************************************//
-const std::vector<int> GenericDetectors::detector_ids(Mesh_ptr mesh)
+const std::vector<int>& GenericDetectors::detector_ids(Mesh_ptr mesh)
 {
   std::map< Mesh_ptr, std::vector< int > >::const_iterator d_it = detector_ids_.find(mesh);
   bool have_detectors = ( d_it != detector_ids_.end() );
@@ -39,7 +39,7 @@ KSPConvergenceFile::KSPConvergenceFile(const std::string &name,
                                        const Bucket *bucket,
                                        const std::string &systemname, 
                                        const std::string &solvername) :
-                                        DiagnosticsFile(name, comm, bucket),
+                                        DiagnosticsFile(name, comm, bucket, (*bucket).binary_diagnostics()),
                                         systemname_(systemname),
                                         solvername_(solvername)
 {
@@ -60,7 +60,7 @@ KSPConvergenceFile::~KSPConvergenceFile()
 void KSPConvergenceFile::write_header()
 {
   header_open_();
-  header_constants_();                                               // write constant tags
+  header_constants_(binary_);                                        // write constant tags
   header_timestep_();                                                // write tags for the timesteps
   header_iteration_();                                               // write tags for the iterations
   header_bucket_();                                                  // write tags for the actual bucket variables - fields etc.
@@ -90,6 +90,8 @@ void KSPConvergenceFile::header_iteration_()
   tag_("NonlinearSystemsIteration", "value");                        // the nonlinear systems iteration
   tag_("NonlinearIteration", "value");                               // the nonlinear solver iteration
   tag_("KSPIteration", "value");                                     // the ksp solver iteration
+  tag_("PCReused", "value");                                         // was the preconditioner reused in this solve
+  tag_("KSPSetupWallTime", "value");                                 // the wall time spent setting up the ksp (and pc)
   
 }
 
@@ -180,6 +182,8 @@ void KSPConvergenceFile::data_iteration_(const int &kspit)
   data_((*bucket_).iteration_count());  
   data_((*sol_ptr).iteration_count());
   data_(kspit);
+  data_((int)(*sol_ptr).pc_reused());
+  data_((*sol_ptr).pc_setup_time());
 }
 
 //*******************************************************************|************************************************************//
@@ -0,0 +1,437 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "KrylovRecycler.h"
+#include "BucketPETScBase.h"
+#include "Logger.h"
+#include <dolfin.h>
+#include <cmath>
+
+using namespace buckettools;
+
+//*******************************************************************|************************************************************//
+// specific constructor
+//*******************************************************************|************************************************************//
+KrylovRecycler::KrylovRecycler(const dolfin::PETScVector &vector,
+                               const int &size) :
+                               size_(size), tetar_(size), tetai_(size),
+                               e_(size*size), g_(size), ework_(size*size),
+                               nstored_(0), active_(false), pc_(PETSC_NULL), 
+                               firstits_(-1)
+{
+  PetscErrorCode perr;
+
+  if (size_ < 1)
+  {
+    tf_err("Krylov recycling requires a recycled space of at least 1 vector.", "size = %d", size_);
+  }
+
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 10
+  tf_err("Krylov recycling requires PETSc >= 3.10.", "PETSc version: %d.%d", PETSC_VERSION_MAJOR, PETSC_VERSION_MINOR);
+  #endif
+
+  perr = VecDuplicateVecs(vector.vec(), size_, &w_); petsc_err(perr); // allocate the recycled space once
+  perr = VecDuplicateVecs(vector.vec(), size_, &s_); petsc_err(perr);
+  perr = VecDuplicateVecs(vector.vec(), size_, &aw_); petsc_err(perr);
+  perr = VecDuplicate(vector.vec(), &r_); petsc_err(perr);
+  perr = VecDuplicate(vector.vec(), &t_); petsc_err(perr);
+}
+
+//*******************************************************************|************************************************************//
+// default destructor
+//*******************************************************************|************************************************************//
+KrylovRecycler::~KrylovRecycler()
+{
+  PetscErrorCode perr;
+
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 1
+  perr = VecDestroyVecs(size_, &w_); petsc_err(perr);
+  perr = VecDestroyVecs(size_, &s_); petsc_err(perr);
+  perr = VecDestroyVecs(size_, &aw_); petsc_err(perr);
+  perr = VecDestroy(&r_); petsc_err(perr);
+  perr = VecDestroy(&t_); petsc_err(perr);
+  if (pc_)
+  {
+    perr = PCDestroy(&pc_); petsc_err(perr);
+  }
+  #else
+  perr = VecDestroyVecs(w_, size_); petsc_err(perr);
+  perr = VecDestroyVecs(s_, size_); petsc_err(perr);
+  perr = VecDestroyVecs(aw_, size_); petsc_err(perr);
+  perr = VecDestroy(r_); petsc_err(perr);
+  perr = VecDestroy(t_); petsc_err(perr);
+  if (pc_)
+  {
+    perr = PCDestroy(pc_); petsc_err(perr);
+  }
+  #endif
+}
+
+//*******************************************************************|************************************************************//
+// attach this recycler to the given ksp, asking it to compute ritz pairs, wrapping its (already configured) pc in a deflating shell
+// pc and setting the pre and post solve callbacks
+//*******************************************************************|************************************************************//
+void KrylovRecycler::attach(KSP &ksp, const std::string &name)
+{
+  PetscErrorCode perr;
+
+  name_ = name;
+
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 9
+  perr = KSPSetComputeRitz(ksp, PETSC_TRUE); petsc_err(perr);
+  #endif
+
+  perr = KSPGetPC(ksp, &pc_); petsc_err(perr);                       // keep a reference to the configured pc so it survives
+  perr = PetscObjectReference((PetscObject) pc_); petsc_err(perr);   // being replaced in the ksp
+
+  PC shell;
+  perr = PCCreate(PetscObjectComm((PetscObject) ksp), &shell); petsc_err(perr);
+  perr = PCSetType(shell, PCSHELL); petsc_err(perr);
+  perr = PCShellSetContext(shell, (void *) this); petsc_err(perr);
+  perr = PCShellSetSetUp(shell, KrylovRecyclerPCSetUp); petsc_err(perr);
+  perr = PCShellSetApply(shell, KrylovRecyclerPCApply); petsc_err(perr);
+  perr = PCShellSetView(shell, KrylovRecyclerPCView); petsc_err(perr);
+  perr = PCShellSetName(shell, "krylov recycling deflation"); petsc_err(perr);
+  perr = PCSetOptionsPrefix(shell, name_.c_str()); petsc_err(perr);
+  perr = PCAppendOptionsPrefix(shell, "recycling_"); petsc_err(perr);
+
+  PetscBool amat, pmat;
+  perr = PCGetOperatorsSet(pc_, &amat, &pmat); petsc_err(perr);
+  if (amat)                                                          // operators already set on the ksp (e.g. picard solvers)
+  {                                                                  // have to be passed on to the shell
+    Mat A, P;
+    #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+    perr = PCGetOperators(pc_, &A, &P, PETSC_NULL); petsc_err(perr);
+    perr = PCSetOperators(shell, A, P, SAME_NONZERO_PATTERN); petsc_err(perr);
+    #else
+    perr = PCGetOperators(pc_, &A, &P); petsc_err(perr);
+    perr = PCSetOperators(shell, A, P); petsc_err(perr);
+    #endif
+  }
+
+  perr = KSPSetPC(ksp, shell); petsc_err(perr);                      // the ksp takes its own reference to the shell
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 1
+  perr = PCDestroy(&shell); petsc_err(perr);
+  #else
+  perr = PCDestroy(shell); petsc_err(perr);
+  #endif
+
+  perr = KSPSetPreSolve(ksp, KrylovRecyclerPreSolve, (void *) this); petsc_err(perr);
+  perr = KSPSetPostSolve(ksp, KrylovRecyclerPostSolve, (void *) this); petsc_err(perr);
+}
+
+//*******************************************************************|************************************************************//
+// project the (current) operator A onto the recycled space W, storing A W and E = W^T A W for the deflated pc applications
+// (the operator may have changed since the space was harvested so this costs m matvecs per solve)
+//*******************************************************************|************************************************************//
+PetscErrorCode KrylovRecycler::project(KSP ksp, Vec b, Vec x)
+{
+  PetscErrorCode perr;
+
+  active_ = false;
+  if (nstored_ == 0)
+  {
+    PetscFunctionReturn(0);
+  }
+
+  Mat A;
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+  perr = KSPGetOperators(ksp, &A, PETSC_NULL, PETSC_NULL); CHKERRQ(perr);
+  #else
+  perr = KSPGetOperators(ksp, &A, PETSC_NULL); CHKERRQ(perr);
+  #endif
+
+  const int m = nstored_;
+  g_.resize(m);
+  for (int j = 0; j < m; j++)
+  {
+    perr = MatMult(A, w_[j], aw_[j]); CHKERRQ(perr);
+    perr = VecMDot(aw_[j], m, w_, &g_[0]); CHKERRQ(perr);            // E_ij = W_i . A W_j
+    for (int i = 0; i < m; i++)
+    {
+      e_[i*m+j] = g_[i];
+    }
+  }
+
+  ework_.assign(e_.begin(), e_.begin()+m*m);                         // check the projected operator is usable
+  g_.assign(m, 1.0);
+  active_ = solve_projected_(ework_, g_);
+  if (!active_)
+  {
+    log(WARNING, "  Krylov recycling projection for %s is singular, skipping deflation.", name_.c_str());
+  }
+
+  PetscFunctionReturn(0);
+}
+
+//*******************************************************************|************************************************************//
+// harvest the harmonic ritz vectors associated with the smallest harmonic ritz values from the last gmres cycle and add the
+// directions they contribute to the recycled space while it has room (the recycled directions are kept as the deflated operator
+// maps them to unit eigenvalues so they would not be harvested again)
+//*******************************************************************|************************************************************//
+PetscErrorCode KrylovRecycler::harvest(KSP ksp, Vec b, Vec x)
+{
+  PetscErrorCode perr;
+
+  PetscInt its;
+  perr = KSPGetIterationNumber(ksp, &its); CHKERRQ(perr);
+  if (firstits_ < 0)
+  {
+    firstits_ = its;                                                 // record the iterations of the first solve
+  }
+  else if (active_)
+  {
+    log(INFO, "  Krylov recycling for %s: %d recycled vectors, %d iterations (%d in the first solve without recycling)",
+                          name_.c_str(), nstored_, (int)its, (int)firstits_);
+  }
+  active_ = false;                                                   // the projection is redone before the next solve
+
+  if (nstored_ == size_)                                             // nothing to do if the space is full
+  {
+    PetscFunctionReturn(0);
+  }
+
+  PetscInt nrit = size_ - nstored_;
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 9
+  perr = KSPComputeRitz(ksp, PETSC_FALSE, PETSC_TRUE, &nrit, s_,    // harmonic ritz vectors with the smallest values
+                        &tetar_[0], &tetai_[0]);
+  CHKERRQ(perr);
+  #else
+  nrit = 0;
+  #endif
+
+  int n = 0;                                                         // modified gram-schmidt against the recycled space
+  for (int i = 0; i < nrit; i++)                                     // (dropping dependent vectors)
+  {
+    PetscReal norm;
+    perr = VecNormalize(s_[i], &norm); CHKERRQ(perr);
+    if (norm == 0.0)
+    {
+      continue;
+    }
+    for (int j = 0; j < nstored_; j++)
+    {
+      PetscScalar dot;
+      perr = VecDot(s_[i], w_[j], &dot); CHKERRQ(perr);
+      perr = VecAXPY(s_[i], -dot, w_[j]); CHKERRQ(perr);
+    }
+    perr = VecNormalize(s_[i], &norm); CHKERRQ(perr);
+    if (norm > 1.e-8)
+    {
+      std::swap(w_[nstored_], s_[i]);                                // move the vector into the recycled space
+      nstored_++;
+      n++;
+    }
+  }
+
+  log(DBG, "  Krylov recycling for %s harvested %d of %d harmonic ritz vectors, %d recycled vectors", 
+                          name_.c_str(), n, (int)nrit, nstored_);
+
+  PetscFunctionReturn(0);
+}
+
+//*******************************************************************|************************************************************//
+// set up the wrapped pc with the operators of the shell pc
+//*******************************************************************|************************************************************//
+PetscErrorCode KrylovRecycler::setup_pc(PC pc)
+{
+  PetscErrorCode perr;
+
+  Mat A, P;
+  #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+  perr = PCGetOperators(pc, &A, &P, PETSC_NULL); CHKERRQ(perr);
+  perr = PCSetOperators(pc_, A, P, SAME_NONZERO_PATTERN); CHKERRQ(perr);
+  #else
+  perr = PCGetOperators(pc, &A, &P); CHKERRQ(perr);
+  perr = PCSetOperators(pc_, A, P); CHKERRQ(perr);
+  #endif
+  perr = PCSetUp(pc_); CHKERRQ(perr);
+
+  PetscFunctionReturn(0);
+}
+
+//*******************************************************************|************************************************************//
+// apply the deflated pc
+//   z = W E^{-1} W^T r + M^{-1} (r - A W E^{-1} W^T r)
+// where M^{-1} is the wrapped pc
+//*******************************************************************|************************************************************//
+PetscErrorCode KrylovRecycler::apply_pc(PC pc, Vec r, Vec z)
+{
+  PetscErrorCode perr;
+
+  if (!active_)
+  {
+    perr = PCApply(pc_, r, z); CHKERRQ(perr);
+    PetscFunctionReturn(0);
+  }
+
+  const int m = nstored_;
+  g_.resize(m);
+  perr = VecMDot(r, m, w_, &g_[0]); CHKERRQ(perr);                   // g = W^T r
+  ework_.assign(e_.begin(), e_.begin()+m*m);
+  solve_projected_(ework_, g_);                                      // y = E^{-1} g (checked in the pre solve)
+
+  perr = VecCopy(r, t_); CHKERRQ(perr);
+  for (int i = 0; i < m; i++)
+  {
+    g_[i] = -g_[i];
+  }
+  perr = VecMAXPY(t_, m, &g_[0], aw_); CHKERRQ(perr);                // t = r - A W y
+  perr = PCApply(pc_, t_, z); CHKERRQ(perr);                         // z = M^{-1} t
+  for (int i = 0; i < m; i++)
+  {
+    g_[i] = -g_[i];
+  }
+  perr = VecMAXPY(z, m, &g_[0], w_); CHKERRQ(perr);                  // z = z + W y
+
+  PetscFunctionReturn(0);
+}
+
+//*******************************************************************|************************************************************//
+// view the deflated pc and the pc it wraps
+//*******************************************************************|************************************************************//
+PetscErrorCode KrylovRecycler::view_pc(PC pc, PetscViewer viewer)
+{
+  PetscErrorCode perr;
+
+  perr = PetscViewerASCIIPrintf(viewer, "  recycled vectors: %d (maximum %d)\n", nstored_, size_); CHKERRQ(perr);
+  perr = PetscViewerASCIIPrintf(viewer, "  wrapped preconditioner:\n"); CHKERRQ(perr);
+  perr = PetscViewerASCIIPushTab(viewer); CHKERRQ(perr);
+  perr = PCView(pc_, viewer); CHKERRQ(perr);
+  perr = PetscViewerASCIIPopTab(viewer); CHKERRQ(perr);
+
+  PetscFunctionReturn(0);
+}
+
+//*******************************************************************|************************************************************//
+// solve the (small, dense) projected system G y = g for y (returned in g) using gaussian elimination with partial pivoting
+// returns false if the system is too poorly conditioned to be used
+//*******************************************************************|************************************************************//
+bool KrylovRecycler::solve_projected_(std::vector<PetscScalar> &G, std::vector<PetscScalar> &g)
+{
+  const int m = g.size();
+
+  double scale = 0.0;
+  for (int i = 0; i < m*m; i++)
+  {
+    scale = std::max(scale, (double)std::abs(G[i]));
+  }
+  if (scale == 0.0)
+  {
+    return false;
+  }
+
+  for (int k = 0; k < m; k++)
+  {
+    int p = k;
+    for (int i = k+1; i < m; i++)
+    {
+      if (std::abs(G[i*m+k]) > std::abs(G[p*m+k]))
+      {
+        p = i;
+      }
+    }
+    if (std::abs(G[p*m+k]) <= 1.e-14*scale)
+    {
+      return false;
+    }
+    if (p != k)
+    {
+      for (int j = 0; j < m; j++)
+      {
+        std::swap(G[k*m+j], G[p*m+j]);
+      }
+      std::swap(g[k], g[p]);
+    }
+    for (int i = k+1; i < m; i++)
+    {
+      const PetscScalar factor = G[i*m+k]/G[k*m+k];
+      for (int j = k; j < m; j++)
+      {
+        G[i*m+j] -= factor*G[k*m+j];
+      }
+      g[i] -= factor*g[k];
+    }
+  }
+
+  for (int i = m-1; i >= 0; i--)                                     // back substitution
+  {
+    for (int j = i+1; j < m; j++)
+    {
+      g[i] -= G[i*m+j]*g[j];
+    }
+    g[i] /= G[i*m+i];
+  }
+
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// ksp pre solve callback that projects the operator onto the recycled space using the recycler passed in the context
+//*******************************************************************|************************************************************//
+PetscErrorCode buckettools::KrylovRecyclerPreSolve(KSP ksp, Vec b, Vec x, void* ctx)
+{
+  KrylovRecycler *recycler = (KrylovRecycler *)ctx;
+  return (*recycler).project(ksp, b, x);
+}
+
+//*******************************************************************|************************************************************//
+// ksp post solve callback that harvests the recycled space using the recycler passed in the context
+//*******************************************************************|************************************************************//
+PetscErrorCode buckettools::KrylovRecyclerPostSolve(KSP ksp, Vec b, Vec x, void* ctx)
+{
+  KrylovRecycler *recycler = (KrylovRecycler *)ctx;
+  return (*recycler).harvest(ksp, b, x);
+}
+
+//*******************************************************************|************************************************************//
+// shell pc set up callback that sets up the wrapped pc of the recycler in the shell context
+//*******************************************************************|************************************************************//
+PetscErrorCode buckettools::KrylovRecyclerPCSetUp(PC pc)
+{
+  PetscErrorCode perr;
+  KrylovRecycler *recycler;
+  perr = PCShellGetContext(pc, (void **) &recycler); CHKERRQ(perr);
+  return (*recycler).setup_pc(pc);
+}
+
+//*******************************************************************|************************************************************//
+// shell pc apply callback that applies the deflated pc of the recycler in the shell context
+//*******************************************************************|************************************************************//
+PetscErrorCode buckettools::KrylovRecyclerPCApply(PC pc, Vec r, Vec z)
+{
+  PetscErrorCode perr;
+  KrylovRecycler *recycler;
+  perr = PCShellGetContext(pc, (void **) &recycler); CHKERRQ(perr);
+  return (*recycler).apply_pc(pc, r, z);
+}
+
+//*******************************************************************|************************************************************//
+// shell pc view callback that views the deflated pc of the recycler in the shell context
+//*******************************************************************|************************************************************//
+PetscErrorCode buckettools::KrylovRecyclerPCView(PC pc, PetscViewer viewer)
+{
+  PetscErrorCode perr;
+  KrylovRecycler *recycler;
+  perr = PCShellGetContext(pc, (void **) &recycler); CHKERRQ(perr);
+  return (*recycler).view_pc(pc, viewer);
+}
+
@@ -0,0 +1,406 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+#include "LagrangianDetectors.h"
+#include "PythonDetectors.h"
+#include "PointLocator.h"
+#include "Bucket.h"
+#include "SystemBucket.h"
+#include "FunctionBucket.h"
+#include "MPIBase.h"
+#include "Logger.h"
+#include <dolfin.h>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+using namespace buckettools;
+
+//*******************************************************************|************************************************************//
+// specific constructor
+//*******************************************************************|************************************************************//
+LagrangianDetectors::LagrangianDetectors(const uint &meshdim, 
+                                         const std::string &function, 
+                                         const std::string &name,
+                                         const Bucket *bucket,
+                                         const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
+                                         const std::string &scheme, const int &nsubsteps) : 
+                  PythonDetectors(meshdim, function, name),
+                  bucket_(bucket), velname_(velocity), 
+                  scheme_(scheme), nsubsteps_(nsubsteps),
+                  initialized_(false)
+{
+  if (nsubsteps_ < 1)
+  {
+    tf_err("Lagrangian detectors need at least one substep.", "Detectors name: %s, number_substeps = %d", 
+           name_.c_str(), nsubsteps_);
+  }
+
+  if (scheme_ == "RK3")                                              // kutta's third order scheme
+  {
+    const double a[9] = {0.0, 0.0, 0.0, 
+                         0.5, 0.0, 0.0, 
+                         -1.0, 2.0, 0.0};
+    const double b[3] = {1.0/6.0, 2.0/3.0, 1.0/6.0};
+    const double c[3] = {0.0, 0.5, 1.0};
+    rka_.assign(a, a+9);
+    rkb_.assign(b, b+3);
+    rkc_.assign(c, c+3);
+  }
+  else if (scheme_ == "RK4")                                         // classical fourth order scheme
+  {
+    const double a[16] = {0.0, 0.0, 0.0, 0.0, 
+                          0.5, 0.0, 0.0, 0.0, 
+                          0.0, 0.5, 0.0, 0.0, 
+                          0.0, 0.0, 1.0, 0.0};
+    const double b[4] = {1.0/6.0, 1.0/3.0, 1.0/3.0, 1.0/6.0};
+    const double c[4] = {0.0, 0.5, 0.5, 1.0};
+    rka_.assign(a, a+16);
+    rkb_.assign(b, b+4);
+    rkc_.assign(c, c+4);
+  }
+  else if (scheme_ == "ForwardEuler")                                // first order scheme
+  {
+    rka_.assign(1, 0.0);
+    rkb_.assign(1, 1.0);
+    rkc_.assign(1, 0.0);
+  }
+  else
+  {
+    tf_err("Unknown advection scheme in LagrangianDetectors.", "Scheme: %s", scheme_.c_str());
+  }
+
+  ownerranks_.resize(rkb_.size());
+  ownercells_.resize(rkb_.size());
+
+  oldpositions_.resize(positions_.size()*meshdim_);
+  for (std::size_t i = 0; i < positions_.size(); i++)
+  {
+    std::copy((*positions_[i]).data(), (*positions_[i]).data()+meshdim_, &oldpositions_[i*meshdim_]);
+  }
+}
+
+//*******************************************************************|************************************************************//
+// default destructor
+//*******************************************************************|************************************************************//
+LagrangianDetectors::~LagrangianDetectors()
+{
+                                                                     // do nothing
+}
+
+//*******************************************************************|************************************************************//
+// advect the detectors through the last timestep (from the old time to the current time) using the runge-kutta scheme with the
+// velocity linearly interpolated in time at each stage
+// each process advects the detectors it owns, evaluating the velocity at stage positions that leave its partition on the process
+// that owns them, before migrating the detectors that have left its partition (collective)
+//*******************************************************************|************************************************************//
+void LagrangianDetectors::advect()
+{
+  init_velocity_();
+
+  const double dt = (*bucket_).current_time() - (*bucket_).old_time();
+  const int rank = dolfin::MPI::rank((*mesh_).mpi_comm());
+  const uint dim = meshdim_;
+
+  const std::vector<int> &detectorids = detector_ids(mesh_);         // evaluates the ownership if necessary
+  const std::vector<int> &cellids = cell_ids(mesh_);
+  const std::size_t ndetectors = detectorids.size();
+  const std::size_t nstages = rkb_.size();
+
+  for (std::size_t i = 0; i < positions_.size(); i++)                // every process knows every position so remember them all
+  {                                                                  // (for checkpointing at the old time)
+    std::copy((*positions_[i]).data(), (*positions_[i]).data()+dim, &oldpositions_[i*dim]);
+  }
+
+  std::vector<double> x(ndetectors*dim), xstage(ndetectors*dim);
+  for (std::size_t p = 0; p < ndetectors; p++)
+  {
+    std::copy((*positions_[detectorids[p]]).data(), 
+              (*positions_[detectorids[p]]).data()+dim, &x[p*dim]);
+  }
+  const std::vector<double> x0(x);                                   // the old positions
+
+  for (std::size_t s = 0; s < nstages; s++)                          // the stages all start near the cells we already know
+  {
+    ownerranks_[s].assign(ndetectors, rank);
+    ownercells_[s] = cellids;
+  }
+
+  std::vector< GenericFunction_ptr > velocities;
+  velocities.push_back(vel_);
+  velocities.push_back(oldvel_);
+
+  const std::vector<bool> active(ndetectors, true);
+  std::vector<double> k(nstages*ndetectors*dim), values;
+  std::vector<bool> found;
+  const double h = dt/nsubsteps_;
+
+  for (int sub = 0; sub < nsubsteps_; sub++)
+  {
+    for (std::size_t s = 0; s < nstages; s++)
+    {
+      for (std::size_t p = 0; p < ndetectors; p++)
+      {
+        for (uint i = 0; i < dim; i++)
+        {
+          double y = x[p*dim+i];
+          for (std::size_t j = 0; j < s; j++)
+          {
+            y += h*rka_[s*nstages+j]*k[(j*ndetectors+p)*dim+i];
+          }
+          xstage[p*dim+i] = y;
+        }
+      }
+
+      (*locator_).eval_distributed(velocities, xstage, active,      // collective
+                                   ownerranks_[s], ownercells_[s], values, found);
+
+      const double theta = (sub + rkc_[s])/nsubsteps_;
+      for (std::size_t p = 0; p < ndetectors; p++)
+      {
+        for (uint i = 0; i < dim; i++)                               // stages that leave the domain don't move the detector
+        {
+          k[(s*ndetectors+p)*dim+i] = found[p] ? 
+                                      theta*values[p*2*dim+i] + (1.0-theta)*values[p*2*dim+dim+i] : 0.0;
+        }
+      }
+    }
+
+    for (std::size_t p = 0; p < ndetectors; p++)
+    {
+      for (uint i = 0; i < dim; i++)
+      {
+        for (std::size_t s = 0; s < nstages; s++)
+        {
+          x[p*dim+i] += h*rkb_[s]*k[(s*ndetectors+p)*dim+i];
+        }
+      }
+    }
+  }
+
+  migrate_(x, x0);
+}
+
+//*******************************************************************|************************************************************//
+// return a python function that gives the current positions of the detectors (or their positions before the last advection if old
+// is true) at full precision, so that a checkpointed simulation restarts with the detectors where they were rather than at their
+// initial positions
+//*******************************************************************|************************************************************//
+const std::string LagrangianDetectors::checkpoint_function(const bool &old) const
+{
+  std::stringstream s;
+  s << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+  s << "def val():" << std::endl;
+  s << "  return [";
+  for (std::size_t i = 0; i < positions_.size(); i++)
+  {
+    const double *x = old ? &oldpositions_[i*meshdim_] : (*positions_[i]).data();
+    s << "[";
+    for (uint j = 0; j < meshdim_; j++)
+    {
+      s << x[j] << ((j+1 < meshdim_) ? ", " : "");
+    }
+    s << "]" << ((i+1 < positions_.size()) ? ", " : "");
+  }
+  s << "]" << std::endl;
+
+  return s.str();
+}
+
+//*******************************************************************|************************************************************//
+// find the velocity the detectors are advected with (this can't be done when the detectors are created as the functions aren't
+// allocated yet)
+//*******************************************************************|************************************************************//
+void LagrangianDetectors::init_velocity_()
+{
+  if (initialized_)
+  {
+    return;
+  }
+  initialized_ = true;
+
+  if(velname_.second.first=="field")
+  {
+    vel_ = (*(*(*bucket_).fetch_system(velname_.first)).
+             fetch_field(velname_.second.second)).
+             genericfunction_ptr((*bucket_).current_time_ptr());
+    oldvel_ = (*(*(*bucket_).fetch_system(velname_.first)).
+             fetch_field(velname_.second.second)).
+             genericfunction_ptr((*bucket_).old_time_ptr());
+  }
+  else
+  {
+    vel_ = (*(*(*bucket_).fetch_system(velname_.first)).
+             fetch_coeff(velname_.second.second)).
+             genericfunction_ptr((*bucket_).current_time_ptr());
+    oldvel_ = (*(*(*bucket_).fetch_system(velname_.first)).
+             fetch_coeff(velname_.second.second)).
+             genericfunction_ptr((*bucket_).old_time_ptr());
+  }
+
+  if ((*vel_).value_size() != meshdim_)
+  {
+    tf_err("Lagrangian detectors velocity must have the same dimension as the mesh.", 
+           "Detectors name: %s, velocity value size = %d, mesh dimension = %d", 
+           name_.c_str(), (int)(*vel_).value_size(), (int)meshdim_);
+  }
+
+  mesh_ = (*(*bucket_).fetch_system(velname_.first)).mesh();         // use the mesh from the velocity system
+  locator_.reset( new PointLocator(mesh_) );
+}
+
+//*******************************************************************|************************************************************//
+// given the new positions, x, (and the old positions, x0) of the detectors owned by this process work out which are still in the
+// cells owned by this process (walking from their old cells), offer the rest to the other processes and let the lowest ranked
+// process that finds one in its cells take it, then share the new positions of all the detectors with all the processes
+// detectors that no process finds have left the domain and are left where they were by the process that owned them (collective)
+//*******************************************************************|************************************************************//
+void LagrangianDetectors::migrate_(std::vector<double> &x, 
+                                   const std::vector<double> &x0)
+{
+  const MPI_Comm mpicomm = (*mesh_).mpi_comm();
+  const int rank = dolfin::MPI::rank(mpicomm);
+  const int nprocs = dolfin::MPI::size(mpicomm);
+  const uint dim = meshdim_;
+  const int cellghostoffset = (*mesh_).topology().ghost_offset((*mesh_).topology().dim());
+
+  const std::vector<int> &detectorids = detector_ids(mesh_);
+  const std::vector<int> &cellids = cell_ids(mesh_);
+  const std::size_t ndetectors = detectorids.size();
+
+  std::vector< std::pair<int, int> > owned;                          // the (detector, cell) pairs owned after the migration
+  std::vector<double> lost;                                          // the detector ids and positions that have left this
+  std::vector<std::size_t> lostlocal;                                // partition (and their local indices)
+  for (std::size_t p = 0; p < ndetectors; p++)
+  {
+    const dolfin::Point lp(dim, &x[p*dim]);
+    const int cellindex = (*locator_).findcell(lp, cellids[p]);
+    if (cellindex >= 0 && cellindex < cellghostoffset)
+    {
+      owned.push_back(std::make_pair(detectorids[p], cellindex));
+    }
+    else
+    {
+      lost.push_back(detectorids[p]);
+      lost.insert(lost.end(), &x[p*dim], &x[p*dim]+dim);
+      lostlocal.push_back(p);
+    }
+  }
+
+  std::vector<double> alllost;
+  std::vector<std::size_t> nlost;
+  dolfin::MPI::all_gather(mpicomm, lost, alllost);
+  dolfin::MPI::all_gather(mpicomm, lostlocal.size(), nlost);
+  const std::size_t nalllost = alllost.size()/(dim+1);
+
+  std::vector<double> lostpoints(nalllost*dim);
+  for (std::size_t l = 0; l < nalllost; l++)
+  {
+    std::copy(&alllost[l*(dim+1)+1], &alllost[l*(dim+1)+1]+dim, &lostpoints[l*dim]);
+  }
+
+  std::vector<int> claims(nalllost, nprocs), claimcells;
+  (*locator_).locate(lostpoints, claimcells);                        // claim the lost detectors that are now in our cells
+  for (std::size_t l = 0; l < nalllost; l++)
+  {
+    if (claimcells[l] >= 0 && claimcells[l] < cellghostoffset)
+    {
+      claims[l] = rank;
+    }
+  }
+#ifdef HAS_MPI
+  if (nprocs > 1 && nalllost > 0)                                    // the lowest ranked claim wins
+  {
+    int mpierr = MPI_Allreduce(MPI_IN_PLACE, &claims[0], nalllost, MPI_INT, MPI_MIN, mpicomm);
+    mpi_err(mpierr);
+  }
+#endif
+
+  std::size_t offset = 0;                                            // the offset of our lost detectors in the gathered list
+  for (int q = 0; q < rank; q++)
+  {
+    offset += nlost[q];
+  }
+
+  std::size_t nstopped = 0;
+  for (std::size_t l = 0; l < nalllost; l++)
+  {
+    if (claims[l] == rank)
+    {
+      owned.push_back(std::make_pair((int)alllost[l*(dim+1)], claimcells[l]));
+    }
+    else if (claims[l] == nprocs && l >= offset && l < offset+lostlocal.size())
+    {                                                                // nobody found it so it's left the domain, keep it where it
+      const std::size_t p = lostlocal[l-offset];                     // was
+      std::copy(&x0[p*dim], &x0[p*dim]+dim, &x[p*dim]);
+      owned.push_back(std::make_pair(detectorids[p], cellids[p]));
+      nstopped++;
+    }
+  }
+
+  nstopped = dolfin::MPI::sum(mpicomm, nstopped);
+  if (nstopped > 0)
+  {
+    log(WARNING, "%d detector(s) in %s left the domain and were stopped at their previous positions.", 
+                 (int)nstopped, name_.c_str());
+  }
+
+  for (std::size_t p = 0; p < ndetectors; p++)                       // update the positions of the detectors we owned
+  {
+    std::copy(&x[p*dim], &x[p*dim]+dim, (*positions_[detectorids[p]]).data());
+  }
+  for (std::size_t l = 0; l < nalllost; l++)                         // and the ones we claimed
+  {
+    if (claims[l] == rank)
+    {
+      std::copy(&alllost[l*(dim+1)+1], &alllost[l*(dim+1)+1]+dim, 
+                (*positions_[(int)alllost[l*(dim+1)]]).data());
+    }
+  }
+
+  std::sort(owned.begin(), owned.end());                             // keep the detectors in order
+
+  std::vector<int> newcellids(owned.size()), newdetectorids(owned.size());
+  std::vector<double> ownedpositions, allpositions;                  // the ids and positions of the detectors we now own
+  ownedpositions.reserve(owned.size()*(dim+1));
+  for (std::size_t i = 0; i < owned.size(); i++)
+  {
+    newdetectorids[i] = owned[i].first;
+    newcellids[i] = owned[i].second;
+    ownedpositions.push_back(owned[i].first);
+    ownedpositions.insert(ownedpositions.end(), (*positions_[owned[i].first]).data(), 
+                                                (*positions_[owned[i].first]).data()+dim);
+  }
+
+  dolfin::MPI::all_gather(mpicomm, ownedpositions, allpositions);   // every process knows every position (for output)
+  for (std::size_t i = 0; i < allpositions.size(); i += dim+1)
+  {
+    std::copy(&allpositions[i+1], &allpositions[i+1]+dim, 
+              (*positions_[(int)allpositions[i]]).data());
+  }
+
+  cell_ids_.clear();                                                 // the ownership on any other meshes will have to be
+  detector_ids_.clear();                                             // reevaluated
+  ufc_cells_.clear();
+  set_ownership_(mesh_, newcellids, newdetectorids);
+}
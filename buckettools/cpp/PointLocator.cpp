@@ -0,0 +1,505 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+#include "PointLocator.h"
+#include "BoostTypes.h"
+#include "Logger.h"
+#include <dolfin.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+using namespace buckettools;
+
+//*******************************************************************|************************************************************//
+// specific constructor
+//*******************************************************************|************************************************************//
+PointLocator::PointLocator(Mesh_ptr mesh) : mesh_(mesh)
+{
+  dim_ = (*mesh_).geometry().dim();
+
+  const uint tdim = (*mesh_).topology().dim();                       // we can only walk through simplices that fill the space
+  walkable_ = (tdim == dim_) && ((*mesh_).type().num_vertices() == tdim+1);
+  if (walkable_)
+  {
+    (*mesh_).init(tdim-1, tdim);
+    (*mesh_).init(tdim, tdim-1);
+  }
+
+  const std::vector<double> &coordinates = (*mesh_).geometry().x(); // bounding box of the local partition
+  bboxmin_.assign(dim_, std::numeric_limits<double>::max());
+  bboxmax_.assign(dim_, -std::numeric_limits<double>::max());
+  for (std::size_t v = 0; v < coordinates.size(); v += dim_)
+  {
+    for (uint i = 0; i < dim_; i++)
+    {
+      bboxmin_[i] = std::min(bboxmin_[i], coordinates[v+i]);
+      bboxmax_[i] = std::max(bboxmax_[i], coordinates[v+i]);
+    }
+  }
+  for (uint i = 0; i < dim_; i++)                                    // pad it a little so points on the boundary aren't missed
+  {
+    const double pad = DOLFIN_EPS_LARGE*std::max(1.0, bboxmax_[i]-bboxmin_[i]);
+    bboxmin_[i] -= pad;
+    bboxmax_[i] += pad;
+  }
+}
+
+//*******************************************************************|************************************************************//
+// default destructor
+//*******************************************************************|************************************************************//
+PointLocator::~PointLocator()
+{
+                                                                     // do nothing
+}
+
+//*******************************************************************|************************************************************//
+// find the local cell containing the point p, walking through the cell neighbours from the hinted cell first and falling back on
+// the bounding box tree if that fails, returning -1 if it isn't on this process
+//*******************************************************************|************************************************************//
+const int PointLocator::findcell(const dolfin::Point &p, 
+                                 const int &hint) const
+{
+  if (hint >= 0 && hint < (int)(*mesh_).num_cells())
+  {
+    const int cell_index = walk(p, hint);
+    if (cell_index >= 0)
+    {
+      return cell_index;
+    }
+  }
+
+  std::vector<unsigned int> cell_indices = (*(*mesh_).bounding_box_tree()).compute_entity_collisions(p);
+  if (cell_indices.size()==0)
+  {
+    return -1;
+  }
+  return cell_indices[0];
+}
+
+//*******************************************************************|************************************************************//
+// walk from the start cell towards the point p, at each step moving to the neighbour across the facet opposite the vertex with the
+// most negative barycentric coordinate of p, returning the cell containing p or -1 if the walk leaves the local mesh (or doesn't
+// arrive within a reasonable number of steps)
+//*******************************************************************|************************************************************//
+const int PointLocator::walk(const dolfin::Point &p, 
+                             const int &start) const
+{
+  if (!walkable_)                                                    // just check the start cell
+  {
+    dolfin::Cell dolfincell(*mesh_, start);
+    return dolfincell.collides(p) ? start : -1;
+  }
+
+  const uint maxsteps = 64;
+  const dolfin::MeshGeometry &geometry = (*mesh_).geometry();
+  double J[9], lambda[4];
+  int current = start, previous = -1;
+
+  for (uint step = 0; step < maxsteps; step++)
+  {
+    dolfin::Cell dolfincell(*mesh_, current);
+    const unsigned int *vertices = dolfincell.entities(0);
+    const double *x0 = geometry.x(vertices[0]);
+
+    for (uint j = 0; j < dim_; j++)                                  // solve J lambda = p - x0 for the barycentric coordinates
+    {
+      const double *xj = geometry.x(vertices[j+1]);
+      for (uint i = 0; i < dim_; i++)
+      {
+        J[i*dim_+j] = xj[i] - x0[i];
+      }
+      lambda[j+1] = p[j] - x0[j];
+    }
+
+    bool singular = false;                                           // gaussian elimination with partial pivoting
+    for (uint k = 0; k < dim_ && !singular; k++)
+    {
+      uint q = k;
+      for (uint i = k+1; i < dim_; i++)
+      {
+        if (std::abs(J[i*dim_+k]) > std::abs(J[q*dim_+k]))
+        {
+          q = i;
+        }
+      }
+      if (std::abs(J[q*dim_+k]) < DOLFIN_EPS*dolfincell.h())
+      {
+        singular = true;
+        break;
+      }
+      if (q != k)
+      {
+        for (uint j = 0; j < dim_; j++)
+        {
+          std::swap(J[k*dim_+j], J[q*dim_+j]);
+        }
+        std::swap(lambda[k+1], lambda[q+1]);
+      }
+      for (uint i = k+1; i < dim_; i++)
+      {
+        const double factor = J[i*dim_+k]/J[k*dim_+k];
+        for (uint j = k; j < dim_; j++)
+        {
+          J[i*dim_+j] -= factor*J[k*dim_+j];
+        }
+        lambda[i+1] -= factor*lambda[k+1];
+      }
+    }
+    if (singular)
+    {
+      return dolfincell.collides(p) ? current : -1;
+    }
+    lambda[0] = 1.0;
+    for (int i = dim_-1; i >= 0; i--)                                // back substitution
+    {
+      for (uint j = i+1; j < dim_; j++)
+      {
+        lambda[i+1] -= J[i*dim_+j]*lambda[j+1];
+      }
+      lambda[i+1] /= J[i*dim_+i];
+      lambda[0] -= lambda[i+1];
+    }
+
+    uint vmin = 0;
+    for (uint v = 1; v <= dim_; v++)
+    {
+      if (lambda[v] < lambda[vmin])
+      {
+        vmin = v;
+      }
+    }
+    if (lambda[vmin] >= -DOLFIN_EPS_LARGE)                           // p is in this cell
+    {
+      return current;
+    }
+
+    int next = -1;
+    for (dolfin::FacetIterator facet(dolfincell); !facet.end(); ++facet)
+    {                                                                // find the facet opposite vertex vmin
+      bool opposite = true;
+      for (dolfin::VertexIterator vertex(*facet); !vertex.end(); ++vertex)
+      {
+        if ((*vertex).index() == vertices[vmin])
+        {
+          opposite = false;
+          break;
+        }
+      }
+      if (opposite)
+      {
+        if ((*facet).num_entities(dim_) == 2)                        // otherwise we've hit the edge of the local mesh
+        {
+          const unsigned int *neighbours = (*facet).entities(dim_);
+          next = ((int)neighbours[0] == current) ? neighbours[1] : neighbours[0];
+        }
+        break;
+      }
+    }
+
+    if (next < 0 || next == previous)                                // off the local mesh or going round in circles
+    {
+      return -1;
+    }
+    previous = current;
+    current = next;
+  }
+
+  return -1;
+}
+
+//*******************************************************************|************************************************************//
+// find the local cells containing a batch of points (point major, npoints*dim), returning -1 for points that aren't on this
+// process
+// points outside the bounding box of the local partition are rejected straight away and the rest are sorted along a morton (z-order)
+// curve so that each can be found by walking from the cell the previous point was found in, only falling back on the bounding box
+// tree when the walk fails
+// (collective, as the tree may need building and only the processes with points in their bounding box would otherwise build it)
+//*******************************************************************|************************************************************//
+void PointLocator::locate(const std::vector<double> &points, 
+                          std::vector<int> &cells) const
+{
+  (*mesh_).bounding_box_tree();                                      // make sure every process has built the (collective) tree
+
+  const std::size_t npoints = points.size()/dim_;
+  cells.assign(npoints, -1);
+
+  std::vector<double> lower(dim_, std::numeric_limits<double>::max());
+  std::vector<double> upper(dim_, -std::numeric_limits<double>::max());
+  std::vector<std::size_t> inside;
+  for (std::size_t p = 0; p < npoints; p++)                          // filter against the local bounding box
+  {
+    if (inbbox_(&points[p*dim_]))
+    {
+      inside.push_back(p);
+      for (uint i = 0; i < dim_; i++)
+      {
+        lower[i] = std::min(lower[i], points[p*dim_+i]);
+        upper[i] = std::max(upper[i], points[p*dim_+i]);
+      }
+    }
+  }
+
+  const uint bits = 63/dim_;                                         // bits per dimension in the morton key
+  const double nbins = std::ldexp(1.0, bits) - 1.0;
+  std::vector< std::pair<uint64_t, std::size_t> > keys(inside.size());
+  for (std::size_t j = 0; j < inside.size(); j++)
+  {
+    const std::size_t p = inside[j];
+    uint64_t key = 0;
+    for (uint i = 0; i < dim_; i++)
+    {
+      const double extent = upper[i] - lower[i];
+      const uint64_t bin = (extent > 0.0) ? 
+                           (uint64_t)((points[p*dim_+i]-lower[i])/extent*nbins) : 0;
+      for (uint b = 0; b < bits; b++)                                // interleave the bits of the bins
+      {
+        key |= ((bin >> b) & (uint64_t)1) << (b*dim_+i);
+      }
+    }
+    keys[j] = std::make_pair(key, p);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  int previous = -1;
+  for (std::size_t j = 0; j < keys.size(); j++)                      // walk from the last point found
+  {
+    const std::size_t p = keys[j].second;
+    const dolfin::Point lp(dim_, &points[p*dim_]);
+    cells[p] = findcell(lp, previous);
+    if (cells[p] >= 0)
+    {
+      previous = cells[p];
+    }
+  }
+}
+
+//*******************************************************************|************************************************************//
+// return true if the point x is in the (padded) bounding box of the local partition
+//*******************************************************************|************************************************************//
+const bool PointLocator::inbbox_(const double *x) const
+{
+  for (uint i = 0; i < dim_; i++)
+  {
+    if (x[i] < bboxmin_[i] || x[i] > bboxmax_[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// evaluate a list of functions at the point x in the given local cell, concatenating their values
+//*******************************************************************|************************************************************//
+void PointLocator::eval_local(const std::vector< GenericFunction_ptr > &functions,
+                              const double *x, const int &cellindex, 
+                              double *values) const
+{
+  ufc::cell ufccell;
+  dolfin::Cell dolfincell(*mesh_, cellindex);
+  dolfincell.get_cell_data(ufccell);
+
+  const dolfin::Array<double> xp(dim_, const_cast<double*>(x));
+  std::size_t offset = 0;
+  for (std::vector< GenericFunction_ptr >::const_iterator f_it = functions.begin(); 
+                                                          f_it != functions.end(); f_it++)
+  {
+    dolfin::Array<double> vp((**f_it).value_size(), &values[offset]);
+    (**f_it).eval(vp, xp, ufccell);
+    offset += (**f_it).value_size();
+  }
+}
+
+//*******************************************************************|************************************************************//
+// evaluate a list of functions at the active points (point major, npoints*dim), returning their concatenated values (point major)
+// and whether each point was found in the domain
+// points are first looked for on this process, those that aren't found are sent to the process that owned them in the last
+// evaluation (if any) or else to all the processes whose bounding boxes they collide with, before the points sent to a process
+// that no longer owns them are retried with the bounding boxes
+// the process and cell owning each point are returned in owners and cells, which the caller should keep and pass back in next
+// time the same points (or points close to them) are evaluated so that most points only need one exchange
+//*******************************************************************|************************************************************//
+void PointLocator::eval_distributed(const std::vector< GenericFunction_ptr > &functions,
+                                    const std::vector<double> &points, 
+                                    const std::vector<bool> &active,
+                                    std::vector<int> &owners,
+                                    std::vector<int> &cells,
+                                    std::vector<double> &values,
+                                    std::vector<bool> &found) const
+{
+  const MPI_Comm mpicomm = (*mesh_).mpi_comm();
+  const int rank = dolfin::MPI::rank(mpicomm);
+  const std::size_t nprocs = dolfin::MPI::size(mpicomm);
+  const std::size_t npoints = active.size();
+
+  (*mesh_).bounding_box_tree();                                      // make sure every process has built the (collective) tree
+
+  std::size_t valuesize = 0;
+  for (std::vector< GenericFunction_ptr >::const_iterator f_it = functions.begin(); 
+                                                          f_it != functions.end(); f_it++)
+  {
+    valuesize += (**f_it).value_size();
+  }
+
+  owners.resize(npoints, -1);                                        // no cached owners yet
+  cells.resize(npoints, -1);
+
+  values.assign(npoints*valuesize, 0.0);
+  found.assign(npoints, false);
+
+  std::vector<std::size_t> remote;                                   // points not found on this process
+  for (std::size_t p = 0; p < npoints; p++)
+  {
+    if (!active[p])
+    {
+      continue;
+    }
+
+    if (owners[p] < 0 || owners[p] == rank)
+    {
+      const dolfin::Point lp(dim_, &points[p*dim_]);
+      cells[p] = findcell(lp, (owners[p] == rank) ? cells[p] : -1);
+      if (cells[p] >= 0)
+      {
+        owners[p] = rank;
+        eval_local(functions, &points[p*dim_], cells[p], &values[p*valuesize]);
+        found[p] = true;
+        continue;
+      }
+      owners[p] = -1;
+    }
+
+    remote.push_back(p);
+  }
+
+  if (nprocs == 1)
+  {
+    return;
+  }
+
+  for (uint round = 0; round < 2; round++)
+  {
+    std::vector< std::vector<double> > sendpoints(nprocs), recvpoints(nprocs);
+    std::vector< std::vector<std::size_t> > sent(nprocs);
+    for (std::vector<std::size_t>::const_iterator r_it = remote.begin(); r_it != remote.end(); r_it++)
+    {
+      const std::size_t p = *r_it;
+      const dolfin::Point lp(dim_, &points[p*dim_]);
+
+      std::vector<unsigned int> targets;
+      if (round == 0 && owners[p] >= 0)                              // try the cached owner first
+      {
+        targets.push_back(owners[p]);
+      }
+      else
+      {
+        if (round == 1)                                              // it may have come back to this process
+        {
+          const int cellindex = findcell(lp, -1);
+          if (cellindex >= 0)
+          {
+            owners[p] = rank;
+            cells[p] = cellindex;
+            eval_local(functions, &points[p*dim_], cells[p], &values[p*valuesize]);
+            found[p] = true;
+            continue;
+          }
+        }
+        targets = (*(*mesh_).bounding_box_tree()).compute_process_collisions(lp);
+      }
+
+      for (std::vector<unsigned int>::const_iterator t_it = targets.begin(); t_it != targets.end(); t_it++)
+      {
+        if ((int)*t_it == rank || (round == 1 && (int)*t_it == owners[p]))
+        {
+          continue;
+        }
+        sendpoints[*t_it].push_back(((int)*t_it == owners[p]) ? cells[p] : -1);
+        sendpoints[*t_it].insert(sendpoints[*t_it].end(), &points[p*dim_], &points[p*dim_]+dim_);
+        sent[*t_it].push_back(p);
+      }
+    }
+
+    dolfin::MPI::all_to_all(mpicomm, sendpoints, recvpoints);
+
+    std::vector< std::vector<double> > sendvalues(nprocs), recvvalues(nprocs);
+    for (std::size_t q = 0; q < nprocs; q++)                         // evaluate the points other processes have sent us,
+    {                                                                // replying with the cell they're in followed by the values
+      const std::vector<double> &qpoints = recvpoints[q];
+      for (std::size_t i = 0; i < qpoints.size(); i += dim_+1)
+      {
+        const dolfin::Point lp(dim_, &qpoints[i+1]);
+        const int cellindex = findcell(lp, (int)qpoints[i]);
+        sendvalues[q].push_back(cellindex);
+        const std::size_t offset = sendvalues[q].size();
+        sendvalues[q].resize(offset+valuesize, 0.0);
+        if (cellindex >= 0)
+        {
+          eval_local(functions, &qpoints[i+1], cellindex, &sendvalues[q][offset]);
+        }
+      }
+    }
+
+    dolfin::MPI::all_to_all(mpicomm, sendvalues, recvvalues);
+
+    for (std::size_t q = 0; q < nprocs; q++)                         // and collect the replies to the points we sent
+    {
+      for (std::size_t j = 0; j < sent[q].size(); j++)
+      {
+        const std::size_t p = sent[q][j];
+        const double *reply = &recvvalues[q][j*(valuesize+1)];
+        if (reply[0] >= 0 && !found[p])
+        {
+          owners[p] = q;
+          cells[p] = (int)reply[0];
+          std::copy(reply+1, reply+1+valuesize, &values[p*valuesize]);
+          found[p] = true;
+        }
+      }
+    }
+
+    std::vector<std::size_t> retry;                                  // points whose cached owner didn't have them
+    for (std::vector<std::size_t>::const_iterator r_it = remote.begin(); r_it != remote.end(); r_it++)
+    {
+      const std::size_t p = *r_it;
+      if (!found[p])
+      {
+        if (round == 0 && owners[p] >= 0)
+        {
+          retry.push_back(p);
+        }
+        else
+        {
+          owners[p] = -1;
+          cells[p] = -1;
+        }
+      }
+    }
+    remote = retry;
+
+    if (dolfin::MPI::sum(mpicomm, remote.size()) == 0)
+    {
+      break;
+    }
+  }
+}
+
@@ -22,9 +22,11 @@
 #include "Python.h"
 #include "PythonExpression.h"
 #include "PythonInstance.h"
+#include "BatchRecorder.h"
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
+#include <cstring>
 
 using namespace buckettools;
 
@@ -33,7 +35,8 @@ using namespace buckettools;
 //*******************************************************************|************************************************************//
 PythonExpression::PythonExpression(const std::string &function) : 
                                                 dolfin::Expression(), 
-                                                pyinst_(function)
+                                                pyinst_(function), 
+                                                recorder_(value_shape())
 {
   assert(pyinst_.number_arguments()==1);
 }
@@ -44,7 +47,8 @@ PythonExpression::PythonExpression(const std::string &function) :
 PythonExpression::PythonExpression(const std::size_t &dim, 
                                    const std::string &function) : 
                                             dolfin::Expression(dim), 
-                                            pyinst_(function)
+                                            pyinst_(function), 
+                                            recorder_(value_shape())
 {
   assert(pyinst_.number_arguments()==1);
 }
@@ -56,7 +60,8 @@ PythonExpression::PythonExpression(const std::vector< std::size_t >
                                                       &value_shape, 
                                    const std::string &function) : 
                                      dolfin::Expression(value_shape), 
-                                     pyinst_(function)
+                                     pyinst_(function), 
+                                     recorder_(value_shape)
 {
   assert(pyinst_.number_arguments()==1);
 }
@@ -67,7 +72,8 @@ PythonExpression::PythonExpression(const std::vector< std::size_t >
 PythonExpression::PythonExpression(const std::string &function, const double_ptr time) : 
                                                 dolfin::Expression(), 
                                                 pyinst_(function), 
-                                                time_(time)
+                                                time_(time), 
+                                                recorder_(value_shape())
 {
   assert((pyinst_.number_arguments()==1)||(pyinst_.number_arguments()==2));
 }
@@ -80,7 +86,8 @@ PythonExpression::PythonExpression(const std::size_t &dim,
                                    const double_ptr time) : 
                                             dolfin::Expression(dim), 
                                             pyinst_(function),
-                                            time_(time)
+                                            time_(time),
+                                            recorder_(value_shape())
 {
   assert((pyinst_.number_arguments()==1)||(pyinst_.number_arguments()==2));
 }
@@ -94,7 +101,8 @@ PythonExpression::PythonExpression(const std::vector< std::size_t >
                                    const double_ptr time) : 
                                      dolfin::Expression(value_shape), 
                                      pyinst_(function),
-                                     time_(time)
+                                     time_(time),
+                                     recorder_(value_shape)
 {
   assert((pyinst_.number_arguments()==1)||(pyinst_.number_arguments()==2));
 }
@@ -109,10 +117,19 @@ PythonExpression::~PythonExpression()
 
 //*******************************************************************|************************************************************//
 // overload dolfin eval
+// vectorized expressions expect arrays of points so are passed on to eval_batch with a single point
 //*******************************************************************|************************************************************//
 void PythonExpression::eval(dolfin::Array<double>& values, 
                             const dolfin::Array<double>& x) const
 {
+  if (pyinst_.vectorized())
+  {
+    std::vector<double> xp(x.data(), x.data()+x.size()), vp;
+    eval_batch(vp, xp, 1);
+    std::copy(vp.begin(), vp.end(), values.data());
+    return;
+  }
+
   PyObject *pArgs, *pPos, *pT, *px, *pxx, *pResult;
   std::size_t meshdim;
   
@@ -199,6 +216,164 @@ void PythonExpression::eval(dolfin::Array<double>& values,
   
 }
 
+//*******************************************************************|************************************************************//
+// overload dolfin restrict so that vectorized expressions are evaluated at all the points of a cell in a single python call
+//*******************************************************************|************************************************************//
+void PythonExpression::restrict(double* w, const dolfin::FiniteElement& element,
+                                const dolfin::Cell& dolfin_cell, 
+                                const double* coordinate_dofs,
+                                const ufc::cell& ufc_cell) const
+{
+  if (!pyinst_.vectorized())
+  {
+    dolfin::Expression::restrict(w, element, dolfin_cell, coordinate_dofs, ufc_cell);
+    return;
+  }
+
+  recorder_.record();                                                // the recorder and values are reused from cell to cell
+  element.evaluate_dofs(w, recorder_, coordinate_dofs,               // find the points the dofs are evaluated at
+                        ufc_cell.orientation, ufc_cell);
+
+  eval_batch(cellvalues_, recorder_.points(), recorder_.npoints());
+
+  recorder_.replay(cellvalues_);
+  element.evaluate_dofs(w, recorder_, coordinate_dofs,               // evaluate the dofs using the batch of values
+                        ufc_cell.orientation, ufc_cell);
+}
+
+//*******************************************************************|************************************************************//
+// evaluate the expression at a batch of points, x (point major, npoints*dim), returning the values (point major,
+// npoints*value_size)
+// vectorized expressions do this in a single python call, passing the points as an (npoints, dim) numpy array, otherwise eval
+// is called at each point in turn
+//*******************************************************************|************************************************************//
+void PythonExpression::eval_batch(std::vector<double> &values, 
+                                  const std::vector<double> &x,
+                                  const std::size_t &npoints) const
+{
+  const std::size_t valuesize = value_size();
+  values.resize(npoints*valuesize);
+  if (npoints == 0)
+  {
+    return;
+  }
+
+  if (!pyinst_.vectorized())
+  {
+    const std::size_t dim = x.size()/npoints;
+    for (std::size_t p = 0; p < npoints; p++)
+    {
+      const dolfin::Array<double> xp(dim, const_cast<double*>(&x[p*dim]));
+      dolfin::Array<double> vp(valuesize, &values[p*valuesize]);
+      eval(vp, xp);
+    }
+    return;
+  }
+
+  PyObject *pArgs, *pResult;
+
+  int nargs = pyinst_.number_arguments();
+  pArgs = PyTuple_New(nargs+2);                                      // coordinates buffer, number of points, value size (and time)
+  PyTuple_SetItem(pArgs, 0, PyMemoryView_FromMemory((char*)&x[0], 
+                                                    x.size()*sizeof(double), PyBUF_READ));
+  PyTuple_SetItem(pArgs, 1, PyLong_FromSize_t(npoints));
+  PyTuple_SetItem(pArgs, 2, PyLong_FromSize_t(valuesize));
+  if (nargs==2)
+  {
+    PyTuple_SetItem(pArgs, 3, PyFloat_FromDouble(*time_));
+  }
+
+  if (PyErr_Occurred()){                                             // error check - in setting arguments
+    pyinst_.print_error();
+    tf_err("In PythonExpression::eval_batch setting pArgs.", "Python error occurred.");
+  }
+
+  pResult = pyinst_.call_batch(pArgs);                               // call the python function on the whole batch
+
+  if (PyErr_Occurred()){                                             // error check - in running user defined function
+    pyinst_.print_error();
+    tf_err("In PythonExpression::eval_batch evaluating pResult.", "Python error occurred.");
+  }
+
+  Py_buffer view;                                                    // read the values straight out of the returned array
+  if (PyObject_GetBuffer(pResult, &view, PyBUF_C_CONTIGUOUS) != 0)
+  {
+    pyinst_.print_error();
+    tf_err("In PythonExpression::eval_batch reading pResult.", "Python error occurred.");
+  }
+  if (view.len != (Py_ssize_t)(values.size()*sizeof(double)))
+  {
+    tf_err("Vectorized python expression returned the wrong number of values.", 
+           "Expected %d values, got %d.", (int)values.size(), (int)(view.len/sizeof(double)));
+  }
+  std::memcpy(&values[0], view.buf, view.len);
+  PyBuffer_Release(&view);
+
+  Py_DECREF(pResult);                                                // destroy the result python object
+
+  Py_DECREF(pArgs);                                                  // destroy the input arugments object
+}
+
+//*******************************************************************|************************************************************//
+// interpolate the expression into the given function
+// vectorized expressions are evaluated in batches of cells, collecting the points at which the dofs of every cell in the batch are
+// evaluated and passing them to python together, otherwise this is just the standard dolfin interpolation
+//*******************************************************************|************************************************************//
+void PythonExpression::interpolate(dolfin::Function &function) const
+{
+  if (!pyinst_.vectorized())
+  {
+    function.interpolate(*this);
+    return;
+  }
+
+  const std::size_t batchsize = 1024;                                // number of cells per python call
+
+  const dolfin::FunctionSpace &functionspace = *function.function_space();
+  const dolfin::Mesh &mesh = *functionspace.mesh();
+  const dolfin::FiniteElement &element = *functionspace.element();
+  const dolfin::GenericDofMap &dofmap = *functionspace.dofmap();
+  dolfin::GenericVector &vector = *function.vector();
+
+  std::vector<double> coordinate_dofs;
+  ufc::cell ufc_cell;
+  std::vector<double> cell_coefficients(dofmap.max_element_dofs());
+  std::vector<double> values;
+  BatchRecorder recorder(value_shape());
+
+  const std::size_t ncells = mesh.num_cells();
+  for (std::size_t c0 = 0; c0 < ncells; c0 += batchsize)
+  {
+    const std::size_t c1 = std::min(c0+batchsize, ncells);
+
+    recorder.record();
+    for (std::size_t c = c0; c < c1; c++)                            // collect the points in this batch of cells
+    {
+      const dolfin::Cell cell(mesh, c);
+      cell.get_coordinate_dofs(coordinate_dofs);
+      cell.get_cell_data(ufc_cell);
+      element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                            ufc_cell.orientation, ufc_cell);
+    }
+
+    eval_batch(values, recorder.points(), recorder.npoints());       // evaluate them all at once
+
+    recorder.replay(values);
+    for (std::size_t c = c0; c < c1; c++)                            // and set the dofs of each cell from the batch of values
+    {
+      const dolfin::Cell cell(mesh, c);
+      cell.get_coordinate_dofs(coordinate_dofs);
+      cell.get_cell_data(ufc_cell);
+      element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                            ufc_cell.orientation, ufc_cell);
+      auto dofs = dofmap.cell_dofs(c);
+      vector.set_local(cell_coefficients.data(), dofs.size(), dofs.data());
+    }
+  }
+
+  vector.apply("insert");
+}
+
 //*******************************************************************|************************************************************//
 // return if this expression is time dependent or not
 //*******************************************************************|************************************************************//
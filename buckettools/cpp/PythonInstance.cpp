@@ -32,7 +32,9 @@ using namespace buckettools;
 // specific constructor
 //*******************************************************************|************************************************************//
 PythonInstance::PythonInstance(const std::string &function) : 
-                                                  function_(function)
+                                                  function_(function),
+                                                  pBatchFunc_(NULL),
+                                                  vectorized_(false)
 {
   init_();                                                           // initialize
 }
@@ -53,6 +55,16 @@ PyObject* PythonInstance::call(PyObject *pArgs) const
   return PyObject_CallObject(pFunc_, pArgs);
 }
 
+//*******************************************************************|************************************************************//
+// given a python arguments object (a buffer of point coordinates, the number of points and the value size followed by any other
+// arguments) call the val function on the whole batch and return a contiguous array of the values (point major)
+//*******************************************************************|************************************************************//
+PyObject* PythonInstance::call_batch(PyObject *pArgs) const
+{
+  assert(vectorized_);
+  return PyObject_CallObject(pBatchFunc_, pArgs);
+}
+
 //*******************************************************************|************************************************************//
 // print an error message
 //*******************************************************************|************************************************************//
@@ -106,6 +118,52 @@ void PythonInstance::init_()
     print_error();
     tf_err("In PythonInstance::init_ evaluating nargs_.", "Python error occurred.");
   }
+
+  pythonbuffer.str("");                                              // check if val has been marked as accepting arrays of points
+  pythonbuffer << "_vectorized = bool(getattr(val, 'vectorized', False))" 
+               << std::endl;
+  PyObject* tmppVecCode = PyRun_String(pythonbuffer.str().c_str(),
+                                Py_file_input, pGlobals, pLocals_); 
+  PyObject* pVectorized = PyDict_GetItemString(pLocals_, "_vectorized");
+  vectorized_ = false;
+  if (pVectorized)                                                   // only set if the check above ran successfully
+  {
+    vectorized_ = (PyObject_IsTrue(pVectorized) == 1);
+  }
+
+  if (vectorized_)                                                   // define a wrapper that presents the coordinates as an
+  {                                                                  // (npoints, dim) array and returns (npoints, value size) values
+                                                                     // - a single value is taken as constant (this can't be
+                                                                     //   confused with anything else if there's more than one point)
+                                                                     // - otherwise the points are the first dimension unless
+                                                                     //   val.components_first is set (the layout is never guessed
+                                                                     //   from the shape as it is ambiguous when npoints==value size)
+    pythonbuffer.str("");
+    pythonbuffer << "import numpy as _numpy" << std::endl
+                 << "_components_first = bool(getattr(val, 'components_first', False))" << std::endl
+                 << "def _val_batch(_buffer, _npoints, _valuesize, *_args):" << std::endl
+                 << "  _x = _numpy.frombuffer(_buffer, dtype=_numpy.float64).reshape(_npoints, -1)" << std::endl
+                 << "  _v = _numpy.asarray(val(_x, *_args), dtype=_numpy.float64)" << std::endl
+                 << "  if _v.size == _valuesize:" << std::endl
+                 << "    return _numpy.ascontiguousarray(_numpy.broadcast_to(_v.reshape(1, _valuesize), (_npoints, _valuesize)))" << std::endl
+                 << "  if _v.size != _npoints*_valuesize:" << std::endl
+                 << "    raise ValueError('vectorized val returned %d values, expected %d' % (_v.size, _npoints*_valuesize))" << std::endl
+                 << "  if _components_first:" << std::endl
+                 << "    return _numpy.ascontiguousarray(_v.reshape(_valuesize, _npoints).T)" << std::endl
+                 << "  if _v.shape[0] != _npoints:" << std::endl
+                 << "    raise ValueError('vectorized val must return the points as the first dimension (or set val.components_first = True)')" << std::endl
+                 << "  return _numpy.ascontiguousarray(_v.reshape(_npoints, _valuesize))" << std::endl;
+    PyObject* tmppBatchCode = PyRun_String(pythonbuffer.str().c_str(),
+                                  Py_file_input, pGlobals, pLocals_); 
+    pBatchFunc_ = PyDict_GetItemString(pLocals_, "_val_batch");
+    Py_XDECREF(tmppBatchCode);
+  }
+  Py_XDECREF(tmppVecCode);
+  
+  if (PyErr_Occurred()){                                             // check for errors in getting the function
+    print_error();
+    tf_err("In PythonInstance::init_ setting up vectorized evaluation.", "Python error occurred.");
+  }
   
 }
 
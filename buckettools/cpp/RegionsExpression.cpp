@@ -20,10 +20,13 @@
 
 
 #include "RegionsExpression.h"
+#include "PythonExpression.h"
+#include "BatchRecorder.h"
 #include "BoostTypes.h"
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
+#include <algorithm>
 
 using namespace buckettools;
 
@@ -37,7 +40,7 @@ RegionsExpression::RegionsExpression(std::map< std::size_t,
                                             expressions_(expressions),
                                             cell_ids_(cell_ids)
 {
-                                                                     // do nothing
+  fill_table_();
 }
 
 //*******************************************************************|************************************************************//
@@ -51,7 +54,7 @@ RegionsExpression::RegionsExpression(const uint &dim,
                                      expressions_(expressions),
                                      cell_ids_(cell_ids)
 {
-                                                                     // do nothing
+  fill_table_();
 }
 
 //*******************************************************************|************************************************************//
@@ -65,7 +68,7 @@ RegionsExpression::RegionsExpression(const uint &dim0, const uint &dim1,
                                      expressions_(expressions),
                                      cell_ids_(cell_ids)
 {
-                                                                     // do nothing
+  fill_table_();
 }
 
 //*******************************************************************|************************************************************//
@@ -80,7 +83,7 @@ RegionsExpression::RegionsExpression(const std::vector<std::size_t>
                                      expressions_(expressions),
                                      cell_ids_(cell_ids)
 {
-                                                                     // do nothing
+  fill_table_();
 }
 
 //*******************************************************************|************************************************************//
@@ -99,15 +102,206 @@ void RegionsExpression::eval(dolfin::Array<double>& values,
                                       const dolfin::Array<double>& x, 
                                       const ufc::cell &cell) const
 {
-  uint id = (*cell_ids_)[cell.index];
-  size_t_Expression_const_it e_it = expressions_.find(id);
-  if (e_it == expressions_.end())
+  const std::size_t id = (*cell_ids_)[cell.index];
+  const dolfin::Expression *expression = expression_(id);
+  if (!expression)
   {
-    tf_err("Unknown region id in RegionsExpression eval.", "Region id: %d", id);
+    tf_err("Unknown region id in RegionsExpression eval.", "Region id: %d", (int)id);
   }
   else
   {
-    (*(*e_it).second).eval(values, x, cell);
+    (*expression).eval(values, x, cell);
+  }
+}
+
+//*******************************************************************|************************************************************//
+// interpolate the expression into the given function, visiting the cells one region at a time so that each sub-expression is
+// restricted to all of its cells together (and vectorized python sub-expressions are evaluated in batches of cells)
+//*******************************************************************|************************************************************//
+void RegionsExpression::interpolate(dolfin::Function &function) const
+{
+  const dolfin::FunctionSpace &functionspace = *function.function_space();
+  const dolfin::Mesh &mesh = *functionspace.mesh();
+  const dolfin::FiniteElement &element = *functionspace.element();
+  const dolfin::GenericDofMap &dofmap = *functionspace.dofmap();
+  dolfin::GenericVector &vector = *function.vector();
+
+  if (mesh.num_cells() != (*cell_ids_).size())                       // the cell ids don't describe this mesh so fall back on the
+  {                                                                  // standard interpolation
+    function.interpolate(*this);
+    return;
+  }
+
+  if (regioncells_.empty())
+  {
+    fill_regioncells_();
+  }
+
+  const std::size_t batchsize = 1024;                                // number of cells per python call
+
+  std::vector<double> coordinate_dofs;
+  ufc::cell ufc_cell;
+  std::vector<double> cell_coefficients(dofmap.max_element_dofs());
+  std::vector<double> values;
+  BatchRecorder recorder(value_shape());
+
+  for (std::map< std::size_t, std::vector<std::size_t> >::const_iterator r_it = regioncells_.begin(); 
+                                                                       r_it != regioncells_.end(); r_it++)
+  {
+    const std::size_t id = (*r_it).first;
+    const std::vector<std::size_t> &cells = (*r_it).second;
+    if (!expression_(id))
+    {
+      tf_err("Unknown region id in RegionsExpression interpolate.", "Region id: %d", (int)id);
+    }
+
+    const dolfin::Expression &expression = *expression_(id);
+    const PythonExpression *pyexpression = dynamic_cast< const PythonExpression* >(&expression);
+
+    if (pyexpression && (*pyexpression).vectorized())
+    {
+      for (std::size_t c0 = 0; c0 < cells.size(); c0 += batchsize)
+      {
+        const std::size_t c1 = std::min(c0+batchsize, cells.size());
+
+        recorder.record();
+        for (std::size_t c = c0; c < c1; c++)                        // collect the points in this batch of cells
+        {
+          const dolfin::Cell cell(mesh, cells[c]);
+          cell.get_coordinate_dofs(coordinate_dofs);
+          cell.get_cell_data(ufc_cell);
+          element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                                ufc_cell.orientation, ufc_cell);
+        }
+
+        (*pyexpression).eval_batch(values, recorder.points(), recorder.npoints());
+
+        recorder.replay(values);
+        for (std::size_t c = c0; c < c1; c++)                        // and set the dofs of each cell from the batch of values
+        {
+          const dolfin::Cell cell(mesh, cells[c]);
+          cell.get_coordinate_dofs(coordinate_dofs);
+          cell.get_cell_data(ufc_cell);
+          element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                                ufc_cell.orientation, ufc_cell);
+          auto dofs = dofmap.cell_dofs(cells[c]);
+          vector.set_local(cell_coefficients.data(), dofs.size(), dofs.data());
+        }
+      }
+    }
+    else
+    {
+      for (std::vector<std::size_t>::const_iterator c_it = cells.begin(); c_it != cells.end(); c_it++)
+      {
+        const dolfin::Cell cell(mesh, *c_it);
+        cell.get_coordinate_dofs(coordinate_dofs);
+        cell.get_cell_data(ufc_cell);
+        expression.restrict(cell_coefficients.data(), element, cell, 
+                            coordinate_dofs.data(), ufc_cell);
+        auto dofs = dofmap.cell_dofs(*c_it);
+        vector.set_local(cell_coefficients.data(), dofs.size(), dofs.data());
+      }
+    }
+  }
+
+  vector.apply("insert");
+}
+
+//*******************************************************************|************************************************************//
+// return if any of the region expressions depend on time (constants don't and expressions that don't report their dependence are
+// assumed to)
+//*******************************************************************|************************************************************//
+const bool RegionsExpression::time_dependent() const
+{
+  for (size_t_Expression_const_it e_it = expressions_.begin(); e_it != expressions_.end(); e_it++)
+  {
+    if (std::dynamic_pointer_cast< dolfin::Constant >((*e_it).second))
+    {
+      continue;
+    }
+    std::shared_ptr< ExpressionDependence > dependence = std::dynamic_pointer_cast< ExpressionDependence >((*e_it).second);
+    if (!dependence || (*dependence).time_dependent())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//*******************************************************************|************************************************************//
+// return if all of the region expressions only depend on position and time (constants do and expressions that don't report their
+// dependence are assumed to depend on anything)
+//*******************************************************************|************************************************************//
+const bool RegionsExpression::time_only() const
+{
+  for (size_t_Expression_const_it e_it = expressions_.begin(); e_it != expressions_.end(); e_it++)
+  {
+    if (std::dynamic_pointer_cast< dolfin::Constant >((*e_it).second))
+    {
+      continue;
+    }
+    std::shared_ptr< ExpressionDependence > dependence = std::dynamic_pointer_cast< ExpressionDependence >((*e_it).second);
+    if (!dependence || !(*dependence).time_only())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// fill the dense table from region id to expression (the table is indexed by region id so is only filled if the ids are dense
+// enough, i.e. the largest id is no more than 1024 or 8 times the number of regions, otherwise lookups fall back on the map)
+//*******************************************************************|************************************************************//
+void RegionsExpression::fill_table_()
+{
+  table_.clear();
+  if (expressions_.empty())
+  {
+    return;
+  }
+
+  const std::size_t maxid = (*expressions_.rbegin()).first;          // the map is ordered so the last id is the largest
+  if (maxid >= std::max((std::size_t)1024, 8*expressions_.size()))
+  {
+    log(DBG, "Region ids in RegionsExpression too sparse for a table (largest id %d), using the map.", (int)maxid);
+    return;
+  }
+
+  table_.resize(maxid+1);
+  for (size_t_Expression_const_it e_it = expressions_.begin(); e_it != expressions_.end(); e_it++)
+  {
+    table_[(*e_it).first] = (*e_it).second;
+  }
+}
+
+//*******************************************************************|************************************************************//
+// fill the lists of (local) cells in each region from the cell ids
+//*******************************************************************|************************************************************//
+void RegionsExpression::fill_regioncells_() const
+{
+  regioncells_.clear();
+  for (std::size_t c = 0; c < (*cell_ids_).size(); c++)
+  {
+    regioncells_[(*cell_ids_)[c]].push_back(c);
+  }
+}
+
+//*******************************************************************|************************************************************//
+// return the expression for a region id (from the dense table if there is one, otherwise from the map) or null if there isn't one
+//*******************************************************************|************************************************************//
+const dolfin::Expression* RegionsExpression::expression_(const std::size_t &id) const
+{
+  if (!table_.empty())
+  {
+    return (id < table_.size()) ? table_[id].get() : NULL;
+  }
+
+  size_t_Expression_const_it e_it = expressions_.find(id);
+  if (e_it == expressions_.end())
+  {
+    return NULL;
   }
+  return (*e_it).second.get();
 }
 
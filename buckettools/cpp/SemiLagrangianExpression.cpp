@@ -21,8 +21,12 @@
 #include "SemiLagrangianExpression.h"
 #include "BoostTypes.h"
 #include "Bucket.h"
+#include "BatchRecorder.h"
+#include "PointLocator.h"
 #include "Logger.h"
 #include <dolfin.h>
+#include <algorithm>
+#include <cmath>
 
 using namespace buckettools;
 
@@ -32,16 +36,19 @@ using namespace buckettools;
 SemiLagrangianExpression::SemiLagrangianExpression(const Bucket *bucket, const double_ptr time,
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &function,
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside) :
+                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                                                   const std::string &scheme, const int &nsubsteps) :
                                                       dolfin::Expression(), 
                                                       bucket_(bucket), 
                                                       time_(time),
                                                       funcname_(function),
                                                       velname_(velocity),
                                                       outname_(outside),
+                                                      scheme_(scheme),
+                                                      nsubsteps_(nsubsteps),
                                                       initialized_(false)
 {
-  tf_not_parallelized("SemiLagrangianExpression");
+                                                                     // do nothing
 }
     
 //*******************************************************************|************************************************************//
@@ -51,16 +58,19 @@ SemiLagrangianExpression::SemiLagrangianExpression(const std::size_t &dim,
                                                    const Bucket *bucket, const double_ptr time, 
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &function,
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside) :
+                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                                                   const std::string &scheme, const int &nsubsteps) :
                                                       dolfin::Expression(dim), 
                                                       bucket_(bucket), 
                                                       time_(time),
                                                       funcname_(function),
                                                       velname_(velocity),
                                                       outname_(outside),
+                                                      scheme_(scheme),
+                                                      nsubsteps_(nsubsteps),
                                                       initialized_(false)
 {
-  tf_not_parallelized("SemiLagrangianExpression");
+                                                                     // do nothing
 }
     
 //*******************************************************************|************************************************************//
@@ -70,16 +80,19 @@ SemiLagrangianExpression::SemiLagrangianExpression(const std::vector<std::size_t
                                                    const Bucket *bucket, const double_ptr time, 
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &function,
                                                    const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside) :
+                                                   const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                                                   const std::string &scheme, const int &nsubsteps) :
                                                       dolfin::Expression(value_shape), 
                                                       bucket_(bucket), 
                                                       time_(time),
                                                       funcname_(function),
                                                       velname_(velocity),
                                                       outname_(outside),
+                                                      scheme_(scheme),
+                                                      nsubsteps_(nsubsteps),
                                                       initialized_(false)
 {
-  tf_not_parallelized("SemiLagrangianExpression");
+                                                                     // do nothing
 }
     
 //*******************************************************************|************************************************************//
@@ -97,8 +110,6 @@ SemiLagrangianExpression::~SemiLagrangianExpression()
   oldv_ = NULL;
   delete vstar_;
   vstar_ = NULL;
-  delete cellcache_;
-  cellcache_ = NULL;
 }
 
 //*******************************************************************|************************************************************//
@@ -181,18 +192,95 @@ void SemiLagrangianExpression::init()
     v_            = new dolfin::Array<double>(dim_);
     oldv_         = new dolfin::Array<double>(dim_);
     vstar_        = new dolfin::Array<double>(dim_);
-    cellcache_    = new dolfin::MeshFunction< point_map >(mesh_, dim_);
+
+    npercell_ = 0;                                                   // the caches are allocated when we first see the element
+    currentcell_ = -1;
+    currentpoint_ = 0;
+
+    if (nsubsteps_ < 1)
+    {
+      tf_err("SemiLagrangianExpression requires at least 1 substep.", "nsubsteps = %d", nsubsteps_);
+    }
+
+    if (scheme_ == "RK3")                                            // kutta's third order scheme
+    {
+      const double a[9] = {0.0, 0.0, 0.0, 
+                           0.5, 0.0, 0.0, 
+                           -1.0, 2.0, 0.0};
+      const double b[3] = {1.0/6.0, 2.0/3.0, 1.0/6.0};
+      const double c[3] = {0.0, 0.5, 1.0};
+      rka_.assign(a, a+9);
+      rkb_.assign(b, b+3);
+      rkc_.assign(c, c+3);
+    }
+    else if (scheme_ == "RK4")                                       // classical fourth order scheme
+    {
+      const double a[16] = {0.0, 0.0, 0.0, 0.0, 
+                            0.5, 0.0, 0.0, 0.0, 
+                            0.0, 0.5, 0.0, 0.0, 
+                            0.0, 0.0, 1.0, 0.0};
+      const double b[4] = {1.0/6.0, 1.0/3.0, 1.0/3.0, 1.0/6.0};
+      const double c[4] = {0.0, 0.5, 0.5, 1.0};
+      rka_.assign(a, a+16);
+      rkb_.assign(b, b+4);
+      rkc_.assign(c, c+4);
+    }
+    else if (scheme_ != "Midpoint")
+    {
+      tf_err("Unknown departure point integration scheme in SemiLagrangianExpression.", "Scheme: %s", scheme_.c_str());
+    }
+    rky_.resize(dim_);
+    rkk_.resize(rkb_.size()*dim_);
+
+    (*mesh_).bounding_box_tree();                                    // build the (collective) tree on every process up front
+    locator_.reset( new PointLocator(mesh_) );                       // finds departure points (walking through simplices)
 
   }
 }
   
+//*******************************************************************|************************************************************//
+// overload dolfin expression restrict so that eval knows which cell and evaluation point (in the order the element evaluates its
+// dofs) it is being called for and can use the cache of the cells the departure points were found in last time
+// (only in serial, in parallel use interpolate instead)
+//*******************************************************************|************************************************************//
+void SemiLagrangianExpression::restrict(double* w, const dolfin::FiniteElement& element,
+                                        const dolfin::Cell& dolfin_cell, 
+                                        const double* coordinate_dofs,
+                                        const ufc::cell& ufc_cell) const
+{
+  if (dolfin::MPI::size((*mesh_).mpi_comm()) > 1)
+  {
+    tf_not_parallelized("SemiLagrangianExpression restrict (only interpolation into a function is parallelized)");
+  }
+
+  if (npercell_ == 0)                                                // allocate the caches once from the element layout
+  {
+    BatchRecorder recorder(value_shape());
+    element.evaluate_dofs(w, recorder, coordinate_dofs,
+                          ufc_cell.orientation, ufc_cell);
+    npercell_ = recorder.npoints();
+    midcells_.assign((*mesh_).num_cells()*npercell_, -1);
+    endcells_.assign((*mesh_).num_cells()*npercell_, -1);
+  }
+
+  currentcell_ = ufc_cell.index;
+  currentpoint_ = 0;
+  dolfin::Expression::restrict(w, element, dolfin_cell, coordinate_dofs, ufc_cell);
+  currentcell_ = -1;
+}
+
 //*******************************************************************|************************************************************//
 // overload dolfin expression eval
+// (this only looks for departure points on this process so is only available in serial, in parallel use interpolate instead)
 //*******************************************************************|************************************************************//
 void SemiLagrangianExpression::eval(dolfin::Array<double>& values, 
                                     const dolfin::Array<double>& x, 
                                     const ufc::cell &cell) const
 {
+  if (dolfin::MPI::size((*mesh_).mpi_comm()) > 1)
+  {
+    tf_not_parallelized("SemiLagrangianExpression eval (only interpolation into a function is parallelized)");
+  }
       
   const bool outside = findpoint_(x, cell);
   
@@ -214,14 +302,24 @@ void SemiLagrangianExpression::eval(dolfin::Array<double>& values,
 const bool SemiLagrangianExpression::findpoint_(const dolfin::Array<double>& x, 
                                                 const ufc::cell &cell) const
 {
-  bool outside = false;
+  int nocache[2] = {-1, -1};                                         // only points evaluated through restrict are cached
+  int *midcell = &nocache[0], *endcell = &nocache[1];
+  if (currentcell_ == (int)cell.index && currentpoint_ < npercell_ && cell.index < (*mesh_).num_cells())
+  {
+    const std::size_t slot = currentcell_*npercell_ + currentpoint_;
+    midcell = &midcells_[slot];
+    endcell = &endcells_[slot];
+  }
+  currentpoint_++;
 
-  point_map &points = (*cellcache_)[cell.index];
-  dolfin::Point lp(x.size(), x.data());
-  point_iterator p_it = points.find(lp);
+  if (!rkb_.empty())
+  {
+    return findpoint_rungekutta_(x, cell);
+  }
 
-  findvstar_(x, cell);
+  findvstar_(x, cell, 0.5);
 
+  bool outside = false;
   for (uint k = 0; k < 2; k++)
   {
     for (uint i = 0; i < dim_; i++)
@@ -229,109 +327,425 @@ const bool SemiLagrangianExpression::findpoint_(const dolfin::Array<double>& x,
       xstar_[i] = x[i] - ((*bucket()).timestep()/2.0)*(*vstar_)[i];
     }
 
-    outside = checkpoint_(0, p_it, points, lp);
+    outside = !locatepoint_(*midcell, cell.index);
     if (outside)
     {
-      return true;
+      break;
     }
     dolfin::Array<double> xstar(dim_, xstar_);
-    findvstar_(xstar, *ufccellstar_);
+    findvstar_(xstar, *ufccellstar_, 0.5);
   }
 
+  if (!outside)
+  {
+    for (uint i = 0; i < dim_; i++)
+    {
+      xstar_[i] = x[i] - ((*bucket()).timestep())*(*vstar_)[i];
+    }
+
+    outside = !locatepoint_(*endcell, *midcell);
+  }
+
+  return outside;
+}
+
+//*******************************************************************|************************************************************//
+// find the launch point by integrating back along the velocity with the runge-kutta tableau over nsubsteps_ substeps, locating
+// each stage by walking from the cell the previous stage was found in
+//*******************************************************************|************************************************************//
+const bool SemiLagrangianExpression::findpoint_rungekutta_(const dolfin::Array<double>& x, 
+                                                           const ufc::cell &cell) const
+{
+  const uint nstages = rkb_.size();
+  const double dt = (*bucket()).timestep();
+  const double h = dt/nsubsteps_;
+  int walkcell = cell.index;
+  double theta = 1.0;                                                // time level (0 at the old time, 1 at the new time)
+
   for (uint i = 0; i < dim_; i++)
   {
-    xstar_[i] = x[i] - ((*bucket()).timestep())*(*vstar_)[i];
+    rky_[i] = x[i];
   }
 
-  outside = checkpoint_(1, p_it, points, lp);
-  if (outside)
+  for (uint m = 0; m < (uint)nsubsteps_; m++)
   {
-    return true;
+    for (uint s = 0; s < nstages; s++)
+    {
+      if (m == 0 && s == 0)                                          // the first stage is at the arrival point
+      {
+        findvstar_(x, cell, theta);
+      }
+      else
+      {
+        for (uint i = 0; i < dim_; i++)
+        {
+          xstar_[i] = rky_[i];
+          for (uint j = 0; j < s; j++)
+          {
+            xstar_[i] -= h*rka_[s*nstages+j]*rkk_[j*dim_+i];
+          }
+        }
+
+        if (!locatepoint_(walkcell, walkcell))
+        {
+          return true;
+        }
+        dolfin::Array<double> xstar(dim_, xstar_);
+        findvstar_(xstar, *ufccellstar_, theta - rkc_[s]*h/dt);
+      }
+
+      for (uint i = 0; i < dim_; i++)
+      {
+        rkk_[s*dim_+i] = (*vstar_)[i];
+      }
+    }
+
+    for (uint i = 0; i < dim_; i++)
+    {
+      for (uint s = 0; s < nstages; s++)
+      {
+        rky_[i] -= h*rkb_[s]*rkk_[s*dim_+i];
+      }
+    }
+    theta -= h/dt;
   }
-  return false;
+
+  for (uint i = 0; i < dim_; i++)
+  {
+    xstar_[i] = rky_[i];
+  }
+
+  return !locatepoint_(walkcell, walkcell);
 }
 
 //*******************************************************************|************************************************************//
-// find the time weighted velocity at the requested point, x
+// find the velocity at the requested point, x, linearly interpolated to the time level theta (0 at the old time, 1 at the new time)
 //*******************************************************************|************************************************************//
 void SemiLagrangianExpression::findvstar_(const dolfin::Array<double>& x, 
-                                                const ufc::cell &cell) const
+                                                const ufc::cell &cell,
+                                                const double &theta) const
 {
   (*vel_).eval(*v_, x, cell);
   (*oldvel_).eval(*oldv_, x, cell);
   for (uint i = 0; i < dim_; i++)
   {
-    (*vstar_)[i] = 0.5*( (*v_)[i] + (*oldv_)[i] );
+    (*vstar_)[i] = theta*(*v_)[i] + (1.0-theta)*(*oldv_)[i];
   }
 }
 
 //*******************************************************************|************************************************************//
-// check if the current xstar_ is in the cache and/or is valid
+// locate the current xstar_, starting from the cached cell (or start if nothing is cached) and updating the cache, setting
+// ufccellstar_ and returning true if it is found
 //*******************************************************************|************************************************************//
-const bool SemiLagrangianExpression::checkpoint_(const int &index, 
-                                                 point_iterator &p_it, 
-                                                 point_map &points, 
-                                                 const dolfin::Point &lp) const
+const bool SemiLagrangianExpression::locatepoint_(int &cached, 
+                                                  const int &start) const
 {
-  std::vector<unsigned int> cell_indices;
-  int cell_index;
   const dolfin::Point p(dim_, xstar_);
+  const int cell_index = (*locator_).findcell(p, (cached < 0) ? start : cached);
+  cached = cell_index;
+
+  if (cell_index < 0)
+  {
+    return false;
+  }
+
+  dolfin::Cell dolfincell(*mesh_, cell_index);
+  dolfincell.get_cell_data(*ufccellstar_);
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// interpolate the expression into the given function
+// the points at which the dofs of all the local cells are evaluated are collected and their departure points traced together,
+// sending any that leave this partition to the process that owns them (in a single batch per stage of the trace)
+//*******************************************************************|************************************************************//
+void SemiLagrangianExpression::interpolate(dolfin::Function &function) const
+{
+  const dolfin::FunctionSpace &functionspace = *function.function_space();
+  const dolfin::Mesh &mesh = *functionspace.mesh();
+  const dolfin::FiniteElement &element = *functionspace.element();
+  const dolfin::GenericDofMap &dofmap = *functionspace.dofmap();
+  dolfin::GenericVector &vector = *function.vector();
+
+  std::vector<double> coordinate_dofs;
+  ufc::cell ufc_cell;
+  std::vector<double> cell_coefficients(dofmap.max_element_dofs());
+  BatchRecorder recorder(value_shape());
+  std::vector<int> pointcells;                                       // the cell each point was recorded in
+
+  const std::size_t ncells = mesh.num_cells();
+  recorder.record();
+  for (std::size_t c = 0; c < ncells; c++)                           // collect the points in all the local cells
+  {
+    const dolfin::Cell cell(mesh, c);
+    cell.get_coordinate_dofs(coordinate_dofs);
+    cell.get_cell_data(ufc_cell);
+    element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                          ufc_cell.orientation, ufc_cell);
+    pointcells.resize(recorder.npoints(), c);
+  }
+
+  const std::size_t npoints = recorder.npoints();
+  const std::vector<double> &x = recorder.points();
+  const std::size_t valuesize = value_size();
+
+  const uint ncaches = rkb_.empty() ? 2 : nsubsteps_*rkb_.size();   // one ownership cache per traced stage
+  ownerranks_.resize(ncaches);
+  ownercells_.resize(ncaches);
+  for (uint s = 0; s < ncaches; s++)                                 // the points have changed so start looking for them from the
+  {                                                                  // cells they arrive in
+    if (ownerranks_[s].size() != npoints)
+    {
+      ownerranks_[s].assign(npoints, dolfin::MPI::rank((*mesh_).mpi_comm()));
+      ownercells_[s] = pointcells;
+    }
+  }
 
-  if (p_it != points.end())
+  std::vector<double> xstar(npoints*dim_), values;
+  std::vector<bool> active(npoints, true), outside(npoints, false), found;
+
+  if (rkb_.empty())
   {
-    cell_index = (*p_it).second[index];
+    trace_midpoint_(x, pointcells, xstar, active, outside);
+  }
+  else
+  {
+    trace_rungekutta_(x, pointcells, xstar, active, outside);
+  }
 
-    bool update = false;
-    if (cell_index < 0)
+  (*locator_).eval_distributed(std::vector< GenericFunction_ptr >(1, func_), xstar, active, 
+                               ownerranks_[ncaches-1], ownercells_[ncaches-1], values, found);
+
+  std::size_t noutside = 0;
+  for (std::size_t p = 0; p < npoints; p++)                          // points that left the domain take the outside value
+  {
+    if (outside[p] || (active[p] && !found[p]))
     {
-      update = true;
+      const dolfin::Cell cell(mesh, pointcells[p]);
+      cell.get_cell_data(ufc_cell);
+      const dolfin::Array<double> xp(dim_, &xstar[p*dim_]);
+      dolfin::Array<double> vp(valuesize, &values[p*valuesize]);
+      (*out_).eval(vp, xp, ufc_cell);
+      noutside++;
     }
-    else
+  }
+
+  log(DBG, "  SemiLagrangian: %d of %d departure points outside the domain", (int)noutside, (int)npoints);
+
+  recorder.replay(values);
+  for (std::size_t c = 0; c < ncells; c++)                           // set the dofs of each cell from the traced values
+  {
+    const dolfin::Cell cell(mesh, c);
+    cell.get_coordinate_dofs(coordinate_dofs);
+    cell.get_cell_data(ufc_cell);
+    element.evaluate_dofs(cell_coefficients.data(), recorder, coordinate_dofs.data(),
+                          ufc_cell.orientation, ufc_cell);
+    auto dofs = dofmap.cell_dofs(c);
+    vector.set_local(cell_coefficients.data(), dofs.size(), dofs.data());
+  }
+
+  vector.apply("insert");
+}
+
+//*******************************************************************|************************************************************//
+// trace the departure points, xstar, of a batch of arrival points, x, using the midpoint scheme (two fixed point iterations with the
+// time averaged velocity), marking those that leave the domain on the way as outside (and no longer active)
+//*******************************************************************|************************************************************//
+void SemiLagrangianExpression::trace_midpoint_(const std::vector<double> &x, 
+                                               const std::vector<int> &pointcells,
+                                               std::vector<double> &xstar,
+                                               std::vector<bool> &active,
+                                               std::vector<bool> &outside) const
+{
+  const std::size_t npoints = pointcells.size();
+  const double dt = (*bucket()).timestep();
+
+  std::vector< GenericFunction_ptr > velocities;
+  velocities.push_back(vel_);
+  velocities.push_back(oldvel_);
+
+  std::vector<double> vstar(npoints*dim_), v(2*dim_), stagevalues;
+  std::vector<bool> found;
+
+  for (std::size_t p = 0; p < npoints; p++)                          // the time weighted velocity at the arrival points
+  {
+    const dolfin::Point lp(dim_, &x[p*dim_]);
+    int cellindex = (*locator_).findcell(lp, pointcells[p]);
+    if (cellindex < 0)
+    {
+      cellindex = pointcells[p];
+    }
+    (*locator_).eval_local(velocities, &x[p*dim_], cellindex, &v[0]);
+    for (uint i = 0; i < dim_; i++)
+    {
+      vstar[p*dim_+i] = 0.5*( v[i] + v[dim_+i] );
+    }
+  }
+
+  for (uint k = 0; k < 2; k++)                                       // iterate on the midpoint
+  {
+    for (std::size_t p = 0; p < npoints; p++)
     {
-      dolfin::Cell dolfincell(*mesh_, cell_index);
-      if (!dolfincell.collides(p))
+      if (active[p])
       {
-        update = true;
+        for (uint i = 0; i < dim_; i++)
+        {
+          xstar[p*dim_+i] = x[p*dim_+i] - (dt/2.0)*vstar[p*dim_+i];
+        }
       }
     }
 
-    if (update)
+    (*locator_).eval_distributed(velocities, xstar, active, 
+                                 ownerranks_[0], ownercells_[0], stagevalues, found);
+
+    for (std::size_t p = 0; p < npoints; p++)
     {
-      cell_indices = (*(*mesh_).bounding_box_tree()).compute_entity_collisions(p);
-      if (cell_indices.size()==0)
+      if (active[p])
       {
-        cell_index = -1;
+        if (found[p])
+        {
+          for (uint i = 0; i < dim_; i++)
+          {
+            vstar[p*dim_+i] = 0.5*( stagevalues[p*2*dim_+i] + stagevalues[p*2*dim_+dim_+i] );
+          }
+        }
+        else
+        {
+          outside[p] = true;
+          active[p] = false;
+        }
       }
-      else
+    }
+  }
+
+  for (std::size_t p = 0; p < npoints; p++)                          // the departure points
+  {
+    if (active[p])
+    {
+      for (uint i = 0; i < dim_; i++)
       {
-        cell_index = cell_indices[0];
+        xstar[p*dim_+i] = x[p*dim_+i] - dt*vstar[p*dim_+i];
       }
-      (*p_it).second[index] = cell_index;
     }
   }
-  else
+}
+
+//*******************************************************************|************************************************************//
+// trace the departure points, xstar, of a batch of arrival points, x, by integrating back along the velocity (linearly interpolated
+// in time at each stage) with the runge-kutta tableau over nsubsteps_ substeps, marking those that leave the domain on the way as
+// outside (and no longer active)
+// each stage is evaluated for the whole batch in one go (with one exchange between processes)
+//*******************************************************************|************************************************************//
+void SemiLagrangianExpression::trace_rungekutta_(const std::vector<double> &x, 
+                                                 const std::vector<int> &pointcells,
+                                                 std::vector<double> &xstar,
+                                                 std::vector<bool> &active,
+                                                 std::vector<bool> &outside) const
+{
+  const std::size_t npoints = pointcells.size();
+  const uint nstages = rkb_.size();
+  const double dt = (*bucket()).timestep();
+  const double h = dt/nsubsteps_;
+
+  std::vector< GenericFunction_ptr > velocities;
+  velocities.push_back(vel_);
+  velocities.push_back(oldvel_);
+
+  std::vector<double> y(x), k(npoints*nstages*dim_), v(2*dim_), stagevalues;
+  std::vector<bool> found;
+
+  for (std::size_t p = 0; p < npoints; p++)                          // the first stage is at the arrival points (at the new time)
   {
-    cell_indices = (*(*mesh_).bounding_box_tree()).compute_entity_collisions(p);
-    if (cell_indices.size()==0)
+    const dolfin::Point lp(dim_, &x[p*dim_]);
+    int cellindex = (*locator_).findcell(lp, pointcells[p]);
+    if (cellindex < 0)
     {
-      cell_index = -1;
+      cellindex = pointcells[p];
     }
-    else
+    (*locator_).eval_local(velocities, &x[p*dim_], cellindex, &v[0]);
+    for (uint i = 0; i < dim_; i++)
     {
-      cell_index = cell_indices[0];
+      k[(p*nstages)*dim_+i] = v[i];
     }
-    std::vector<int> cells(2, -1);
-    cells[index] = cell_index;
-    points[lp] = cells;
   }
 
-  if (cell_index<0)
+  uint stage = 0;
+  double theta = 1.0;                                                // time level (0 at the old time, 1 at the new time)
+  for (uint m = 0; m < (uint)nsubsteps_; m++)
   {
-    return true;
-  }
+    for (uint s = 0; s < nstages; s++)
+    {
+      if (m == 0 && s == 0)
+      {
+        continue;
+      }
 
-  dolfin::Cell dolfincell(*mesh_, cell_index);
-  dolfincell.get_cell_data(*ufccellstar_);
-  return false;
+      const double thetas = theta - rkc_[s]*h/dt;
 
+      for (std::size_t p = 0; p < npoints; p++)
+      {
+        if (active[p])
+        {
+          for (uint i = 0; i < dim_; i++)
+          {
+            xstar[p*dim_+i] = y[p*dim_+i];
+            for (uint j = 0; j < s; j++)
+            {
+              xstar[p*dim_+i] -= h*rka_[s*nstages+j]*k[(p*nstages+j)*dim_+i];
+            }
+          }
+        }
+      }
+
+      (*locator_).eval_distributed(velocities, xstar, active, 
+                                   ownerranks_[stage], ownercells_[stage], stagevalues, found);
+      stage++;
+
+      for (std::size_t p = 0; p < npoints; p++)
+      {
+        if (active[p])
+        {
+          if (found[p])
+          {
+            for (uint i = 0; i < dim_; i++)
+            {
+              k[(p*nstages+s)*dim_+i] = thetas*stagevalues[p*2*dim_+i] + (1.0-thetas)*stagevalues[p*2*dim_+dim_+i];
+            }
+          }
+          else
+          {
+            outside[p] = true;
+            active[p] = false;
+          }
+        }
+      }
+    }
+
+    for (std::size_t p = 0; p < npoints; p++)
+    {
+      if (active[p])
+      {
+        for (uint i = 0; i < dim_; i++)
+        {
+          for (uint s = 0; s < nstages; s++)
+          {
+            y[p*dim_+i] -= h*rkb_[s]*k[(p*nstages+s)*dim_+i];
+          }
+        }
+      }
+    }
+    theta -= h/dt;
+  }
+
+  for (std::size_t p = 0; p < npoints; p++)                          // the departure points
+  {
+    if (active[p])
+    {
+      for (uint i = 0; i < dim_; i++)
+      {
+        xstar[p*dim_+i] = y[p*dim_+i];
+      }
+    }
+  }
 }
+
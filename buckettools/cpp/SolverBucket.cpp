@@ -23,17 +23,29 @@
 #include "SolverBucket.h"
 #include "SystemBucket.h"
 #include "Bucket.h"
+#include "FunctionBucket.h"
+#include "PythonExpression.h"
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
 #include <signal.h>
+#include <cmath>
 
 using namespace buckettools;
 
 //*******************************************************************|************************************************************//
 // default constructor
 //*******************************************************************|************************************************************//
-SolverBucket::SolverBucket()
+SolverBucket::SolverBucket() : matrixfree_(false), mffunctionerror_(-1.0), 
+                               mfmemorysaved_(0.0), assemblytime_(0.0), 
+                               systemassemblersetup_(0.0), assemblersetup_(0.0), 
+                               assemblysetupsaved_(0.0), matrixassemblies_(0), 
+                               nonlinearcoeffs_filled_(false), nonlinearcoeffs_all_(false),
+                               reusepc_(false), pcmaxsteps_(0), 
+                               pcgrowthfactor_(2.0), pcsteps_(0), pcbaseits_(-1), 
+                               pclastits_(0), pcreused_(false), pcsetuptime_(0.0),
+                               ew_(false), recyclesize_(0), recoverable_(false), 
+                               failed_(false)
 {
                                                                      // do nothing
 }
@@ -41,7 +53,16 @@ SolverBucket::SolverBucket()
 //*******************************************************************|************************************************************//
 // specific constructor
 //*******************************************************************|************************************************************//
-SolverBucket::SolverBucket(SystemBucket* system) : system_(system)
+SolverBucket::SolverBucket(SystemBucket* system) : matrixfree_(false), mffunctionerror_(-1.0), 
+                                                   mfmemorysaved_(0.0), assemblytime_(0.0), 
+                                                   systemassemblersetup_(0.0), assemblersetup_(0.0), 
+                                                   assemblysetupsaved_(0.0), matrixassemblies_(0), 
+                                                   nonlinearcoeffs_filled_(false), nonlinearcoeffs_all_(false),
+                                                   reusepc_(false), pcmaxsteps_(0), 
+                                                   pcgrowthfactor_(2.0), pcsteps_(0), pcbaseits_(-1), 
+                                                   pclastits_(0), pcreused_(false), pcsetuptime_(0.0), 
+                                                   ew_(false), recyclesize_(0), recoverable_(false), 
+                                                   failed_(false), system_(system)
 {
                                                                      // do nothing
 }
@@ -122,6 +143,9 @@ void SolverBucket::solve()
                           type().c_str());
 
   *iteration_count_ = 0;                                             // an iteration counter
+  assemblytime_ = 0.0;                                               // reset the assembly timer
+  assemblysetupsaved_ = 0.0;                                         // and the estimate of the time saved by reusing the assemblers
+  matrixassemblies_ = 0;                                             // and the count of reassembled matrices
 
   if (type()=="SNES")                                                // this is a petsc snes solver - FIXME: switch to an enumerated type
   {                                                                  // loop over the collected vector of system bcs
@@ -155,8 +179,10 @@ void SolverBucket::solve()
 
     assert(residual_);                                               // we need to assemble the residual again here as it may depend
                                                                      // on other systems that have been solved since the last call
-    dolfin::Assembler assemblerres;
-    assemblerres.assemble(*res_, *residual_);                        // assemble the residual
+    double starttime = MPI_Wtime();
+    (*assembler_).assemble(*res_, *residual_);                       // assemble the residual
+    assemblytime_ += MPI_Wtime() - starttime;
+    reused_assembler();                                              // (one assembler used to be built per picard solve)
     for(std::vector< std::shared_ptr<const dolfin::DirichletBC> >::const_iterator bc = 
                           (*system_).bcs_begin(); 
                           bc != (*system_).bcs_end(); bc++)
@@ -170,6 +196,7 @@ void SolverBucket::solve()
                                                                      // being the case it will be necessary to assemble the residual
                                                                      // here too)
     double aerror0 = aerror;                                         // record the initial absolute error
+    double aerrorold = aerror;                                       // record the previous absolute error
     double rerror;
     if(aerror==0.0)
     {
@@ -210,37 +237,62 @@ void SolverBucket::solve()
     (*(*(*system_).iteratedfunction()).vector()) =                   // system iterated function gets set to the function values
                                 (*(*(*system_).function()).vector());
 
+    if (anderson_)
+    {
+      (*anderson_).reset();                                          // forget the history from any previous solves
+    }
+
     while (iteration_count() < minits_ ||                            // loop for the minimum number of iterations or
           (iteration_count() < maxits_ &&                            // up to the maximum number of iterations 
                            rerror > rtol_ && aerror > atol_))        // until the max is reached or a tolerance criterion is
     {                                                                // satisfied
       (*iteration_count_)++;                                         // increment iteration counter
+      reused_system_assemblers();                                    // (the system assemblers used to be rebuilt every iteration)
 
-      dolfin::SystemAssembler assembler(bilinear_, linear_,
-                                        (*system_).bcs());
-      assembler.assemble(*matrix_, *rhs_);
+      if (reusepc_)
+      {
+        pcreused_ = reuse_pc_();                                     // decide if the preconditioner is to be lagged
+      }
+
+      if (ew_)
+      {
+        update_ksp_rtol_(aerror, aerrorold);                         // adapt the linear solver tolerance to the nonlinear
+      }                                                              // convergence
+      aerrorold = aerror;
 
-      if(ident_zeros_)
+      starttime = MPI_Wtime();
+      if (form_changed(bilinear_))                                   // only reassemble the matrix if its coefficients have changed
+      {
+        (*systemassembler_).assemble(*matrix_, *rhs_);               // reuse the persistent assembler (and matrix sparsity)
+
+        if(ident_zeros_)
+        {
+          (*matrix_).ident_zeros();
+        }
+      }
+      else
       {
-        (*matrix_).ident_zeros();
+        (*systemassembler_).assemble(*rhs_);                         // the rhs always has to be reassembled
       }
 
       if (bilinearpc_)                                               // if there's a pc associated
       {
         assert(matrixpc_);
-        dolfin::SystemAssembler assemblerpc(bilinearpc_, linear_,
-                                          (*system_).bcs());
-        assemblerpc.assemble(*matrixpc_);
-
-        if(ident_zeros_pc_)
+        assert(systemassemblerpc_);
+        if (form_changed(bilinearpc_))
         {
-          (*matrixpc_).ident_zeros();
+          (*systemassemblerpc_).assemble(*matrixpc_);
+
+          if(ident_zeros_pc_)
+          {
+            (*matrixpc_).ident_zeros();
+          }
         }
 
         #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
         perr = KSPSetOperators(ksp_, (*matrix_).mat(),              // set the ksp operators with two matrices
                                      (*matrixpc_).mat(), 
-                                     SAME_NONZERO_PATTERN); 
+                                     (pcreused_ ? SAME_PRECONDITIONER : SAME_NONZERO_PATTERN)); 
         #else
         perr = KSPSetOperators(ksp_, (*matrix_).mat(),              // set the ksp operators with two matrices
                                      (*matrixpc_).mat()); 
@@ -252,7 +304,7 @@ void SolverBucket::solve()
         #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
         perr = KSPSetOperators(ksp_, (*matrix_).mat(),              // set the ksp operators with the same matrices
                                       (*matrix_).mat(), 
-                                        SAME_NONZERO_PATTERN); 
+                                      (pcreused_ ? SAME_PRECONDITIONER : SAME_NONZERO_PATTERN)); 
         #else
         perr = KSPSetOperators(ksp_, (*matrix_).mat(),              // set the ksp operators with the same matrices
                                       (*matrix_).mat()); 
@@ -263,10 +315,13 @@ void SolverBucket::solve()
       for (Form_const_it f_it = solverforms_begin(); 
                          f_it != solverforms_end(); f_it++)
       {
+        if (!form_changed((*f_it).second))
+        {
+          continue;
+        }
+
         PETScMatrix_ptr solvermatrix = solvermatrices_[(*f_it).first];
-        dolfin::SystemAssembler assemblerform((*f_it).second, linear_,
-                                          (*system_).bcs());
-        assemblerform.assemble(*solvermatrix);
+        (*solversystemassemblers_[(*f_it).first]).assemble(*solvermatrix);
 
         if(solverident_zeros_[(*f_it).first])
         {
@@ -279,6 +334,7 @@ void SolverBucket::solve()
         petsc_err(perr);
 
       }
+      assemblytime_ += MPI_Wtime() - starttime;
 
       if (monitor_norms())
       {
@@ -312,11 +368,31 @@ void SolverBucket::solve()
         }
       }
 
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 4
+      if (reusepc_)
+      {
+        perr = KSPSetReusePreconditioner(ksp_, (pcreused_ ? PETSC_TRUE : PETSC_FALSE));
+        petsc_err(perr);
+      }
+      #endif
+      starttime = MPI_Wtime();
+      perr = KSPSetUp(ksp_); petsc_err(perr);                        // set up the ksp (and pc if it is not being reused)
+      pcsetuptime_ = MPI_Wtime() - starttime;
+
       *work_ = (*(*(*system_).iteratedfunction()).vector());         // set the work vector to the iterated function
       perr = KSPSolve(ksp_, (*rhs_).vec(), (*work_).vec());          // perform a linear solve
       petsc_fail(perr);
       ksp_check_convergence_(ksp_);
-      if (relax_ != 1.0)
+      if (reusepc_)
+      {
+        record_pc_reuse_();
+      }
+      if (anderson_)
+      {
+        (*anderson_).update(*(*(*system_).iteratedfunction()).vector(),// accelerate the update of the iterated function using the
+                            *work_);                                 // work vector and the previous iterations
+      }
+      else if (relax_ != 1.0)
       {
         (*(*(*system_).iteratedfunction()).vector()) *= (1.-relax_); 
         (*(*(*system_).iteratedfunction()).vector()) += *((*work_)*relax_);// update the iterated function with the work vector
@@ -328,7 +404,9 @@ void SolverBucket::solve()
       
 
       assert(residual_);
-      assemblerres.assemble(*res_, *residual_);                      // assemble the residual
+      starttime = MPI_Wtime();
+      (*assembler_).assemble(*res_, *residual_);                     // assemble the residual
+      assemblytime_ += MPI_Wtime() - starttime;
       for(std::vector< std::shared_ptr<const dolfin::DirichletBC> >::const_iterator bc = 
                              (*system_).bcs_begin(); 
                              bc != (*system_).bcs_end(); bc++)
@@ -374,6 +452,11 @@ void SolverBucket::solve()
       {
         log(WARNING, "Ignoring: Picard failure. Solver: %s::%s.", (*system_).name().c_str(), name().c_str());
       }
+      else if (recoverable_)
+      {
+        log(WARNING, "Recording: Picard failure. Solver: %s::%s.", (*system_).name().c_str(), name().c_str());
+        failed_ = true;
+      }
       else
       {
         tf_fail("Picard iterations failed to converge.", "Iteration count, relative error or absolute error too high.");
@@ -389,6 +472,13 @@ void SolverBucket::solve()
     tf_err("Unknown solver type.", "Type: %s", type_.c_str());
   }
 
+  log(DBG, "  Total wall time spent assembling during this solve of %s::%s = %g", 
+                          (*system_).name().c_str(), name().c_str(), 
+                          assemblytime_);
+  log(DBG, "  Wall time saved by reusing the assemblers during this solve of %s::%s ~ %g", 
+                          (*system_).name().c_str(), name().c_str(), 
+                          assemblysetupsaved_);
+
   if (solved_)
   {
     *solved_ = true;
@@ -402,9 +492,9 @@ void SolverBucket::solve()
 double SolverBucket::residual_norm()
 {
   assert(residual_);
-  dolfin::Assembler assembler;
+  assert(assembler_);
 
-  assembler.assemble(*res_, *residual_);
+  (*assembler_).assemble(*res_, *residual_);
   for(std::vector< std::shared_ptr<const dolfin::DirichletBC> >::const_iterator bc = 
                         (*system_).bcs_begin(); 
                         bc != (*system_).bcs_end(); bc++)
@@ -416,6 +506,314 @@ double SolverBucket::residual_norm()
   return norm;
 }
 
+//*******************************************************************|************************************************************//
+// return true if any of the coefficients of the given form have changed since the last time this was called for that form
+// (always true on the first call, which is made when the tensors are first assembled in initialize_tensors_)
+// functions are tracked using the state counter petsc increments every time their vector is modified, constants by their values
+// while any other coefficients (e.g. expressions) are assumed to have always changed
+//*******************************************************************|************************************************************//
+bool SolverBucket::form_changed(const Form_ptr form)
+{
+  PetscErrorCode perr;
+  bool changed = false;
+  std::vector<double> signature;
+
+  const std::vector< std::shared_ptr<const dolfin::GenericFunction> > coefficients = (*form).coefficients();
+  for (std::vector< std::shared_ptr<const dolfin::GenericFunction> >::const_iterator c_it = coefficients.begin();
+                                                                           c_it != coefficients.end(); c_it++)
+  {
+    std::shared_ptr<const dolfin::Function> function = 
+                            std::dynamic_pointer_cast<const dolfin::Function>(*c_it);
+    std::shared_ptr<const dolfin::Constant> constant = 
+                            std::dynamic_pointer_cast<const dolfin::Constant>(*c_it);
+    if (function)
+    {
+      PetscObjectState state;
+      Vec vec = (*std::dynamic_pointer_cast<const dolfin::PETScVector>((*function).vector())).vec();
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR < 5
+      perr = PetscObjectStateQuery((PetscObject)vec, &state);        // petsc increments this every time the vector changes
+      #else
+      perr = PetscObjectStateGet((PetscObject)vec, &state);          // petsc increments this every time the vector changes
+      #endif
+      petsc_err(perr);
+      signature.push_back((double)state);
+    }
+    else if (constant)
+    {
+      std::vector<double> values = (*constant).values();
+      signature.insert(signature.end(), values.begin(), values.end());
+    }
+    else
+    {
+      changed = true;                                                // no way of knowing if an expression has changed
+    }
+  }
+
+  std::map< const dolfin::Form*, std::vector<double> >::iterator s_it = 
+                                    formsignatures_.find(&(*form));
+  if (s_it == formsignatures_.end() || (*s_it).second != signature)
+  {
+    changed = true;
+  }
+  formsignatures_[&(*form)] = signature;                             // record the coefficient states for the next call
+
+  if (changed)
+  {
+    matrixassemblies_++;                                             // the caller will reassemble the matrix
+  }
+  else
+  {
+    log(DBG, "  Coefficients unchanged, skipping reassembly of form in %s::%s", 
+                          (*system_).name().c_str(), name().c_str());
+  }
+
+  return changed;
+}
+
+//*******************************************************************|************************************************************//
+// update the constant functional coefficients that the forms of this solver depend on (directly or through other constant
+// functionals) rather than every nonlinear coefficient in the bucket
+//*******************************************************************|************************************************************//
+void SolverBucket::update_nonlinear()
+{
+  if (!nonlinearcoeffs_filled_)
+  {
+    fill_nonlinear_coeffs_();
+  }
+
+  if (nonlinearcoeffs_all_)
+  {
+    (*(*system_).bucket()).update_nonlinear();
+  }
+  else
+  {
+    for (std::vector< FunctionBucket_ptr >::iterator f_it = nonlinearcoeffs_.begin(); 
+                                                     f_it != nonlinearcoeffs_.end(); f_it++)
+    {
+      (**f_it).update_nonlinear();
+    }
+  }
+}
+
+//*******************************************************************|************************************************************//
+// return the set of coefficients the forms of this solver depend on (directly or through constant functionals)
+//*******************************************************************|************************************************************//
+const std::set< const dolfin::GenericFunction* >& SolverBucket::dependencies()
+{
+  if (!nonlinearcoeffs_filled_)
+  {
+    fill_nonlinear_coeffs_();
+  }
+  return dependencies_;
+}
+
+//*******************************************************************|************************************************************//
+// return true if the forms of this solver depend on coefficients whose own dependencies are unknown (e.g. cpp expressions)
+//*******************************************************************|************************************************************//
+const bool SolverBucket::unknown_dependencies()
+{
+  if (!nonlinearcoeffs_filled_)
+  {
+    fill_nonlinear_coeffs_();
+  }
+  return nonlinearcoeffs_all_;
+}
+
+//*******************************************************************|************************************************************//
+// find the (ordered) list of constant functional coefficients in the bucket that the forms of this solver depend on
+// if the forms depend on something whose dependencies can't be determined (e.g. a cpp expression) then fall back on updating
+// all of the nonlinear coefficients in the bucket
+//*******************************************************************|************************************************************//
+void SolverBucket::fill_nonlinear_coeffs_()
+{
+  std::set< const dolfin::GenericFunction* > &dependencies = dependencies_;
+  dependencies.clear();
+  for (Form_const_it f_it = forms_begin(); f_it != forms_end(); f_it++)
+  {
+    nonlinearcoeffs_all_ = add_form_dependencies_((*f_it).second, dependencies) || nonlinearcoeffs_all_;
+  }
+  for (Form_const_it f_it = solverforms_begin(); f_it != solverforms_end(); f_it++)
+  {
+    nonlinearcoeffs_all_ = add_form_dependencies_((*f_it).second, dependencies) || nonlinearcoeffs_all_;
+  }
+
+  std::vector< FunctionBucket_ptr > candidates;                      // all the constant functional coefficients in bucket order
+  Bucket* bucket = (*system_).bucket();
+  for (SystemBucket_const_it s_it = (*bucket).systems_begin(); 
+                             s_it != (*bucket).systems_end(); s_it++)
+  {
+    for (FunctionBucket_const_it f_it = (*(*s_it).second).coeffs_begin(); 
+                                 f_it != (*(*s_it).second).coeffs_end(); f_it++)
+    {
+      if ((*(*f_it).second).constant_functional())
+      {
+        candidates.push_back((*f_it).second);
+      }
+    }
+  }
+
+  std::vector<bool> needed(candidates.size(), false);
+  bool added = true;
+  while (added && !nonlinearcoeffs_all_)                             // constant functionals may depend on other constant
+  {                                                                  // functionals so keep going until nothing new is found
+    added = false;
+    for (std::size_t i = 0; i < candidates.size(); i++)
+    {
+      if (needed[i])
+      {
+        continue;
+      }
+      FunctionBucket_ptr coeff = candidates[i];
+      if (dependencies.count(&(*(*coeff).function())) > 0 ||
+          dependencies.count(&(*(*coeff).iteratedfunction())) > 0 ||
+          dependencies.count(&(*(*coeff).oldfunction())) > 0)
+      {
+        needed[i] = true;
+        added = true;
+        nonlinearcoeffs_all_ = add_form_dependencies_((*coeff).constant_functional(), dependencies) || nonlinearcoeffs_all_;
+      }
+    }
+  }
+
+  nonlinearcoeffs_.clear();
+  for (std::size_t i = 0; i < candidates.size(); i++)
+  {
+    if (needed[i])
+    {
+      nonlinearcoeffs_.push_back(candidates[i]);
+    }
+  }
+  nonlinearcoeffs_filled_ = true;
+
+  if (nonlinearcoeffs_all_)
+  {
+    log(DBG, "  %s::%s depends on unknown coefficients, updating all nonlinear coefficients", 
+                          (*system_).name().c_str(), name().c_str());
+  }
+  else
+  {
+    log(DBG, "  %s::%s depends on %d of %d nonlinear coefficients", 
+                          (*system_).name().c_str(), name().c_str(), 
+                          (int)nonlinearcoeffs_.size(), (int)candidates.size());
+  }
+}
+
+//*******************************************************************|************************************************************//
+// add the coefficients of the given form to the set of dependencies
+// returns true if any of the coefficients may depend on arbitrary data in the bucket (i.e. anything other than functions,
+// constants or python expressions)
+//*******************************************************************|************************************************************//
+bool SolverBucket::add_form_dependencies_(const Form_ptr form, 
+                                std::set< const dolfin::GenericFunction* > &dependencies)
+{
+  bool unknown = false;
+
+  const std::vector< std::shared_ptr<const dolfin::GenericFunction> > coefficients = (*form).coefficients();
+  for (std::vector< std::shared_ptr<const dolfin::GenericFunction> >::const_iterator c_it = coefficients.begin();
+                                                                           c_it != coefficients.end(); c_it++)
+  {
+    dependencies.insert(&(**c_it));
+    if (!std::dynamic_pointer_cast<const dolfin::Function>(*c_it) &&
+        !std::dynamic_pointer_cast<const dolfin::Constant>(*c_it) &&
+        !std::dynamic_pointer_cast<const PythonExpression>(*c_it))
+    {
+      unknown = true;
+    }
+  }
+
+  return unknown;
+}
+
+//*******************************************************************|************************************************************//
+// decide whether the preconditioner can be reused in the next linear solve - it is rebuilt if it has never been built, if it has
+// been used for the maximum number of steps or if the ksp iteration count has grown too much since it was last rebuilt
+//*******************************************************************|************************************************************//
+bool SolverBucket::reuse_pc_()
+{
+  if (pcbaseits_ < 0)
+  {
+    log(INFO, "  Building preconditioner for %s::%s", 
+                          (*system_).name().c_str(), name().c_str());
+    return false;
+  }
+
+  if (pcmaxsteps_ > 0 && pcsteps_ >= pcmaxsteps_)
+  {
+    log(INFO, "  Rebuilding preconditioner for %s::%s after %d reuses", 
+                          (*system_).name().c_str(), name().c_str(), pcsteps_);
+    return false;
+  }
+
+  if (pclastits_ > pcgrowthfactor_*std::max(pcbaseits_, 1))
+  {
+    log(INFO, "  Rebuilding preconditioner for %s::%s as ksp iterations grew from %d to %d", 
+                          (*system_).name().c_str(), name().c_str(), pcbaseits_, pclastits_);
+    return false;
+  }
+
+  log(INFO, "  Reusing preconditioner for %s::%s (%d uses, ksp iterations %d, %d after rebuild)", 
+                          (*system_).name().c_str(), name().c_str(), pcsteps_, pclastits_, pcbaseits_);
+  return true;
+}
+
+//*******************************************************************|************************************************************//
+// record the ksp iterations taken in the latest linear solve for the preconditioner reuse policy
+//*******************************************************************|************************************************************//
+void SolverBucket::record_pc_reuse_()
+{
+  PetscErrorCode perr;
+  PetscInt kspits;
+
+  perr = KSPGetIterationNumber(ksp_, &kspits); petsc_err(perr);
+  pclastits_ = kspits;
+  if (pcreused_)
+  {
+    pcsteps_++;
+  }
+  else
+  {
+    pcsteps_ = 1;
+    pcbaseits_ = kspits;
+  }
+
+  log(DBG, "  Preconditioner setup wall time for %s::%s = %g (reused = %d)", 
+                          (*system_).name().c_str(), name().c_str(), pcsetuptime_, pcreused_);
+}
+
+//*******************************************************************|************************************************************//
+// set the ksp relative tolerance for the next picard linear solve using the eisenstat-walker (choice 2) forcing term
+//   eta_k = gamma*(r_k/r_{k-1})^alpha
+// safeguarded by max(eta_k, gamma*eta_{k-1}^alpha) when the latter is large and bounded between the requested ksp relative
+// tolerance and a maximum
+//*******************************************************************|************************************************************//
+void SolverBucket::update_ksp_rtol_(const double &aerror, const double &aerrorold)
+{
+  PetscErrorCode perr;
+
+  if (iteration_count() == 1 || aerrorold == 0.0)
+  {
+    ewrtol_ = ewrtol0_;
+  }
+  else
+  {
+    const double ewrtolold = ewrtol_;
+    ewrtol_ = ewgamma_*std::pow(aerror/aerrorold, ewalpha_);
+    const double safeguard = ewgamma_*std::pow(ewrtolold, ewalpha_);
+    if (safeguard > 0.1)                                             // don't let the tolerance drop too quickly
+    {
+      ewrtol_ = std::max(ewrtol_, safeguard);
+    }
+  }
+  ewrtol_ = std::max(std::min(ewrtol_, ewrtolmax_), ewrtolmin_);
+
+  PetscReal atol, dtol;
+  PetscInt maxits;
+  perr = KSPGetTolerances(ksp_, PETSC_NULL, &atol, &dtol, &maxits); petsc_err(perr);
+  perr = KSPSetTolerances(ksp_, ewrtol_, atol, dtol, maxits); petsc_err(perr);
+
+  log(INFO, "  Picard linear solver relative tolerance = %g", ewrtol_);
+}
+
 //*******************************************************************|************************************************************//
 // update the solver at the end of a timestep
 //*******************************************************************|************************************************************//
@@ -719,6 +1117,24 @@ Mat SolverBucket::fetch_solversubmatrix(const std::string &name)
   }
 }
 
+//*******************************************************************|************************************************************//
+// return a pointer to the persistent system assembler for the named solver form
+//*******************************************************************|************************************************************//
+SystemAssembler_ptr SolverBucket::fetch_solversystemassembler(const std::string &name)
+{
+  std::map< std::string, SystemAssembler_ptr >::iterator s_it = 
+                                          solversystemassemblers_.find(name);// check if this name already exists
+  if (s_it == solversystemassemblers_.end())
+  {
+    tf_err("Solver system assembler does not exist in solver.", "Solver form name: %s, SolverBucket name: %s, SystemBucket name: %s",
+           name.c_str(), name_.c_str(), (*system_).name().c_str());
+  }
+  else
+  {
+    return (*s_it).second;                                           // if it does, return it
+  }
+}
+
 //*******************************************************************|************************************************************//
 // return a string describing the contents of the solver bucket
 //*******************************************************************|************************************************************//
@@ -778,6 +1194,11 @@ void SolverBucket::snes_check_convergence_()
     {
       log(WARNING, "Ignoring: SNES failure. Solver: %s::%s, SNESConvergedReason %d.", (*system_).name().c_str(), name().c_str(), snesreason);
     }
+    else if (recoverable_)
+    {
+      log(WARNING, "Recording: SNES failure. Solver: %s::%s, SNESConvergedReason %d.", (*system_).name().c_str(), name().c_str(), snesreason);
+      failed_ = true;
+    }
     else
     {
       tf_fail("SNES failed to converge.", "Solver: %s::%s, SNESConvergedReason: %d.", (*system_).name().c_str(), name().c_str(), snesreason);
@@ -818,6 +1239,11 @@ void SolverBucket::ksp_check_convergence_(KSP &ksp, int indent)
     {
       log(WARNING, "Ignoring: KSP failure. Solver: %s::%s, KSPConvergedReason %d.", (*system_).name().c_str(), name().c_str(), kspreason);
     }
+    else if (recoverable_)
+    {
+      log(WARNING, "Recording: KSP failure. Solver: %s::%s, KSPConvergedReason %d.", (*system_).name().c_str(), name().c_str(), kspreason);
+      failed_ = true;
+    }
     else
     {
       tf_fail("KSP failed to converge.", "Solver: %s::%s, KSPConvergedReason: %d.", (*system_).name().c_str(), name().c_str(), kspreason);
@@ -828,7 +1254,14 @@ void SolverBucket::ksp_check_convergence_(KSP &ksp, int indent)
   indent++;
 
   PC pc;
-  perr = KSPGetPC(ksp, &pc); petsc_err(perr);
+  if (recycler_ && ksp == ksp_)                                      // the recycler wraps the configured pc of the solver ksp
+  {
+    pc = (*recycler_).pc();
+  }
+  else
+  {
+    perr = KSPGetPC(ksp, &pc); petsc_err(perr);
+  }
   #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 3
   PCType pctype;
   #else
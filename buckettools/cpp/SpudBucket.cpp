@@ -21,6 +21,7 @@
 
 #include "GlobalPythonInstance.h"
 #include "PythonDetectors.h"
+#include "LagrangianDetectors.h"
 #include "SpudBucket.h"
 #include "SpudSystemBucket.h"
 #include "SpudBase.h"
@@ -169,6 +170,12 @@ void SpudBucket::fill()
   {
     (*std::dynamic_pointer_cast< SpudSystemBucket >((*sys_it).second)).initialize_solvers();
   }
+
+  fill_systemdependencies_();                                        // now the forms are complete work out which systems depend
+                                                                     // on each other
+
+  fill_anderson_();                                                  // now the functions are complete allocate the nonlinear
+                                                                     // systems anderson acceleration (if requested)
   
   fill_detectors_();                                                 // put the detectors in the bucket
 
@@ -438,6 +445,19 @@ void SpudBucket::fill_timestepping_()
   serr = Spud::get_option(buffer.str(), relax_, 1.0);
   spud_err(buffer.str(), serr);
 
+  buffer.str(""); buffer << "/nonlinear_systems/anderson_acceleration/history_depth";
+  serr = Spud::get_option(buffer.str(), andersondepth_, 0);
+  spud_err(buffer.str(), serr);
+
+  buffer.str(""); buffer << "/nonlinear_systems/lazy_system_solves";
+  lazysolves_ = Spud::have_option(buffer.str());
+  if (lazysolves_)
+  {
+    buffer.str(""); buffer << "/nonlinear_systems/lazy_system_solves/input_change_tolerance";
+    serr = Spud::get_option(buffer.str(), lazychangetol_, (rtol_ ? *rtol_ : 0.0));
+    spud_err(buffer.str(), serr);
+  }
+
   buffer.str(""); buffer << "/nonlinear_systems/ignore_all_convergence_failures";
   ignore_failures_ = Spud::have_option(buffer.str());
 
@@ -586,6 +606,37 @@ void SpudBucket::fill_adaptivetimestepping_()
     }
 
   }
+
+  buffer.str(""); buffer << "/timestepping/timestep/error_control";
+  if (Spud::have_option(buffer.str()))
+  {
+    timestep_errortol_.reset( new double );
+    buffer.str(""); buffer << "/timestepping/timestep/error_control/relative_error";
+    serr = Spud::get_option(buffer.str(), *timestep_errortol_);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << "/timestepping/timestep/error_control/absolute_error";
+    serr = Spud::get_option(buffer.str(), timestep_erroratol_, *timestep_errortol_);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << "/timestepping/timestep/error_control/safety_factor";
+    serr = Spud::get_option(buffer.str(), timestep_safety_, 0.9);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << "/timestepping/timestep/error_control/maximum_rejections";
+    serr = Spud::get_option(buffer.str(), timestep_maxrejections_, 10);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << "/timestepping/timestep/error_control/minimum_timestep";
+    serr = Spud::get_option(buffer.str(), timestep_minimum_, 0.0);
+    spud_err(buffer.str(), serr);
+
+    for (SystemBucket_it sys_it = systems_begin();                   // solver failures now lead to the timestep being retried
+                         sys_it != systems_end(); sys_it++)          // rather than terminating the simulation
+    {
+      (*(*sys_it).second).recoverable_failures(true);
+    }
+  }
   
 }
 
@@ -601,6 +652,9 @@ void SpudBucket::fill_output_()
   serr = Spud::get_option(buffer.str(), output_basename_); 
   spud_err(buffer.str(), serr);
 
+  binary_diagnostics_ = Spud::have_option("/io/binary_diagnostics"); // needed before the systems are filled as the solvers
+                                                                     // allocate their convergence files then
+
   buffer.str(""); buffer << "/io/dump_periods/visualization_period"; // visualization period
   if(Spud::have_option(buffer.str()))
   {
@@ -1063,6 +1117,12 @@ void SpudBucket::fill_baseuflsymbols_(const std::string &optionpath)
                                                     << "]/type/name";
     serr = Spud::get_option(buffer.str(), type);                     // find out the coefficient type
     spud_err(buffer.str(), serr);
+    buffer.str(""); buffer << optionpath << "/coefficient[" << i 
+                                 << "]/type/evaluate_once_per_timestep";
+    if (type=="Expression" && Spud::have_option(buffer.str()))       // expressions evaluated once per timestep are stored in
+    {                                                                // functions so need a coefficient space too
+      type = "Function";
+    }
     if (type=="Function")                                            // if it's a function then register its derived ufl symbols
     {
       buffer.str(""); buffer << optionpath << "/coefficient[" << i 
@@ -1129,6 +1189,60 @@ void SpudBucket::fill_detectors_()
     register_detector(det, detname, detectorpath.str());             // register detector
   }  
   
+  int nldets = Spud::option_count("/io/detectors/lagrangian");       // number of lagrangian detectors
+  for (uint i=0; i<nldets; i++)                                      // loop over lagrangian detectors
+  {
+    std::stringstream detectorpath;
+    detectorpath.str(""); detectorpath << "/io/detectors/lagrangian[" 
+                                                        << i << "]";
+    
+    std::string detname;                                             // detector array name
+    buffer.str(""); buffer << detectorpath.str() << "/name";
+    serr = Spud::get_option(buffer.str(), detname);
+    spud_err(buffer.str(), serr);
+
+    std::string function;                                            // python function describing the initial detector positions
+    buffer.str(""); buffer << detectorpath.str() << "/python";
+    serr = Spud::get_option(buffer.str(), function);
+    spud_err(buffer.str(), serr);
+
+    std::pair< std::string, std::pair< std::string, std::string > > velocity;
+    buffer.str(""); buffer << detectorpath.str() << "/velocity/system/name";
+    serr = Spud::get_option(buffer.str(), velocity.first);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << detectorpath.str() << "/velocity/field";
+    if (Spud::have_option(buffer.str()))
+    {
+      buffer << "/name";
+      velocity.second.first = "field";
+      serr = Spud::get_option(buffer.str(), velocity.second.second);
+      spud_err(buffer.str(), serr);
+    }
+    else
+    {
+      buffer.str(""); buffer << detectorpath.str() << "/velocity/coefficient/name";
+      velocity.second.first = "coefficient";
+      serr = Spud::get_option(buffer.str(), velocity.second.second);
+      spud_err(buffer.str(), serr);
+    }
+
+    std::string scheme;
+    buffer.str(""); buffer << detectorpath.str() << "/advection_scheme/scheme/name";
+    serr = Spud::get_option(buffer.str(), scheme, "RK4");
+    spud_err(buffer.str(), serr);
+
+    int nsubsteps;
+    buffer.str(""); buffer << detectorpath.str() << "/advection_scheme/number_substeps";
+    serr = Spud::get_option(buffer.str(), nsubsteps, 1);
+    spud_err(buffer.str(), serr);
+    
+                                                                     // create lagrangian detectors array
+    det.reset(new LagrangianDetectors(dimension(), function, detname, this, 
+                                      velocity, scheme, nsubsteps));
+    register_detector(det, detname, detectorpath.str());             // register detector
+  }  
+  
 }
 
 //*******************************************************************|************************************************************//
@@ -1147,7 +1261,8 @@ void SpudBucket::fill_diagnostics_()
 
   int npdets = Spud::option_count("/io/detectors/point");            // number of point detectors
   int nadets = Spud::option_count("/io/detectors/array");            // number of array detectors
-  if ((npdets + nadets) > 0)
+  int nldets = Spud::option_count("/io/detectors/lagrangian");       // number of lagrangian detectors
+  if ((npdets + nadets + nldets) > 0)
   {
     if (Spud::option_count("/system/field/diagnostics/include_in_detectors")==0)
     {
@@ -1215,6 +1330,19 @@ void SpudBucket::checkpoint_options_(const double_ptr time)
     spud_err(buffer.str(), serr);
   }
 
+  for (string_const_it s_it = detector_optionpaths_begin();          // restart lagrangian detectors from their positions at this
+                       s_it != detector_optionpaths_end(); s_it++)   // time (every process knows all the positions)
+  {
+    LagrangianDetectors_ptr det = 
+              std::dynamic_pointer_cast< LagrangianDetectors >(fetch_detector((*s_it).first));
+    if (det)
+    {
+      buffer.str(""); buffer << (*s_it).second << "/python";
+      serr = Spud::set_option(buffer.str(), (*det).checkpoint_function(time==old_time_ptr()));
+      spud_err(buffer.str(), serr);
+    }
+  }
+
   if (dolfin::MPI::rank((*(*meshes_begin()).second).mpi_comm())==0)
   {
     namebuffer.str(""); namebuffer << output_basename() 
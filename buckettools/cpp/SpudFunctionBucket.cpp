@@ -20,6 +20,7 @@
 
 
 #include "PythonExpression.h"
+#include "ExpressionDependence.h"
 #include "BoostTypes.h"
 #include "SpudFunctionBucket.h"
 #include "Logger.h"
@@ -250,12 +251,17 @@ void SpudFunctionBucket::initialize_coeff_function()
 
     initialize_expression_over_regions_(tmpexpression, buffer.str());
 
-    (*std::dynamic_pointer_cast< dolfin::Function >(function_)).interpolate(*tmpexpression);
-    (*std::dynamic_pointer_cast< dolfin::Function >(oldfunction_)).interpolate(*tmpexpression);
+    interpolate_(*std::dynamic_pointer_cast< dolfin::Function >(function_), *tmpexpression);
+    interpolate_(*std::dynamic_pointer_cast< dolfin::Function >(oldfunction_), *tmpexpression);
                                                                      // iteratedfunction_ points at function_
     if (time_dependent)
     {
       coefficientfunction_ = tmpexpression;                          // we'll need this again
+      std::shared_ptr< ExpressionDependence > dependence = 
+                          std::dynamic_pointer_cast< ExpressionDependence >(tmpexpression);
+      coefficienttimeonly_ = (dependence && (*dependence).time_only());// but only when the time changes if the expression says it
+                                                                     // only depends on position and time
+      coefficienttime_ = (*(*system_).bucket()).current_time();
     }
 
   }
@@ -335,6 +341,12 @@ void SpudFunctionBucket::fill_base_(const uint &index)
   serr = Spud::get_option(buffer.str(), type_);                      // (as string)
   spud_err(buffer.str(), serr);
 
+  buffer.str(""); buffer << optionpath() << "/type/evaluate_once_per_timestep";
+  if (type_=="Expression" && Spud::have_option(buffer.str()))        // expressions that are only evaluated once per timestep are
+  {                                                                  // treated as coefficient functions on the element of the
+    type_ = "Function";                                              // expression (interpolated at the start of each timestep and
+  }                                                                  // then reused by every assembly in that timestep)
+
   std::string strrank;
   buffer.str(""); buffer << optionpath() << "/type/rank/name";       // field or coefficient rank (as string)
   serr = Spud::get_option(buffer.str(), strrank); 
@@ -1257,10 +1269,9 @@ Expression_ptr SpudFunctionBucket::allocate_expression_(
                                        system(), time);
 
     if (time_dependent)                                              // if we've asked if this expression is time dependent
-    {                                                                // ... check (but by default assume it is)
-      buffer.str(""); buffer << optionpath << "cpp/time_independent";
-      *time_dependent = !Spud::have_option(buffer.str());
-    }
+    {                                                                // ... ask the expression (set from the options when it was
+      *time_dependent = (*std::dynamic_pointer_cast< ExpressionDependence >(expression)).time_dependent();
+    }                                                                // generated, by default assuming it is)
 
   }
   else if (Spud::have_option(intbuffer.str()))                       // not much we can do for this case here except call the constructor
@@ -1333,7 +1344,7 @@ Expression_ptr SpudFunctionBucket::allocate_expression_(
       {
         buffer << "/name";
         outside.second.first = "field";
-        serr = Spud::get_option(buffer.str(), velocity.second.second);
+        serr = Spud::get_option(buffer.str(), outside.second.second);
         spud_err(buffer.str(), serr);
       }
       else
@@ -1345,6 +1356,18 @@ Expression_ptr SpudFunctionBucket::allocate_expression_(
         spud_err(buffer.str(), serr);
       }
 
+      std::string scheme;
+      buffer.str(""); buffer << intbuffer.str() 
+                        << "/algorithm/departure_point_integration/scheme/name";
+      serr = Spud::get_option(buffer.str(), scheme, "Midpoint");
+      spud_err(buffer.str(), serr);
+
+      int nsubsteps;
+      buffer.str(""); buffer << intbuffer.str() 
+                        << "/algorithm/departure_point_integration/number_substeps";
+      serr = Spud::get_option(buffer.str(), nsubsteps, 1);
+      spud_err(buffer.str(), serr);
+
                                                                      // rank of an internal function isn't in the default spud base
                                                                      // language so have added it... but it comes out as a string 
                                                                      // of course!
@@ -1360,19 +1383,22 @@ Expression_ptr SpudFunctionBucket::allocate_expression_(
       {
         expression.reset(new SemiLagrangianExpression(
                                                (*system()).bucket(), time, 
-                                               function, velocity, outside));
+                                               function, velocity, outside,
+                                               scheme, nsubsteps));
       }
       else if (lrank==1)                                              // vector
       {
         expression.reset(new SemiLagrangianExpression(size(),
                                                (*system()).bucket(), time, 
-                                               function, velocity, outside));
+                                               function, velocity, outside,
+                                               scheme, nsubsteps));
       }
       else if (lrank==2)                                              // vector
       {
         expression.reset(new SemiLagrangianExpression(shape_,
                                                (*system()).bucket(), time, 
-                                               function, velocity, outside));
+                                               function, velocity, outside,
+                                               scheme, nsubsteps));
       }
       else
       {
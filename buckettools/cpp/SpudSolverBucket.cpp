@@ -24,6 +24,7 @@
 #include "SpudSolverBucket.h"
 #include <dolfin.h>
 #include <string>
+#include <cmath>
 #include <spud>
 #include "SystemSolversWrapper.h"
 #include "SpudSystemBucket.h"
@@ -97,7 +98,26 @@ void SpudSolverBucket::initialize()
                                     FormFunction, (void *) &ctx_); 
     petsc_err(perr);
 
-    if (bilinearpc_)                                                 // if we have a pc form
+    if (matrixfree_)                                                 // if the jacobian action is matrix-free
+    {
+      assert(matrixpc_);
+      Mat mfmatrix;
+      perr = MatCreateSNESMF(snes_, &mfmatrix); petsc_err(perr);     // finite difference the residual to get the jacobian action
+      if (mffunctionerror_ > 0.0)
+      {
+        perr = MatMFFDSetFunctionError(mfmatrix, mffunctionerror_); 
+        petsc_err(perr);
+      }
+      perr = SNESSetJacobian(snes_, mfmatrix,                        // set the snes jacobian to the matrix-free operator and use
+                  (*matrixpc_).mat(), FormJacobian, (void *) &ctx_); // the assembled pc matrix to precondition it
+      petsc_err(perr);
+      #if PETSC_VERSION_MAJOR == 3 && PETSC_VERSION_MINOR > 1
+      perr = MatDestroy(&mfmatrix); petsc_err(perr);                 // the snes keeps its own reference
+      #else
+      perr = MatDestroy(mfmatrix); petsc_err(perr);                  // the snes keeps its own reference
+      #endif
+    }
+    else if (bilinearpc_)                                            // if we have a pc form
     {
       assert(matrixpc_);
       perr = SNESSetJacobian(snes_, (*matrix_).mat(),               // set the snes jacobian to have two matrices
@@ -364,6 +384,12 @@ void SpudSolverBucket::initialize()
     buffer.str(""); buffer << optionpath() << "/type/linear_solver"; // the ksp solver path
     fill_ksp_(buffer.str(), ksp_, prefix.str());                     // can then be used to fill the ksp data
 
+    if (recyclesize_ > 0)                                            // recycle a deflation space between the linear solves
+    {
+      recycler_.reset( new KrylovRecycler(*work_, recyclesize_) );
+      (*recycler_).attach(ksp_, prefix.str());
+    }
+
     buffer.str(""); buffer << optionpath() << "/type/monitors/view_snes";
     if (Spud::have_option(buffer.str()))
     {
@@ -419,6 +445,19 @@ void SpudSolverBucket::initialize()
     buffer.str(""); buffer << optionpath() << "/type/linear_solver"; // figure out the linear solver optionspath
     fill_ksp_(buffer.str(), ksp_, prefix.str());                     // fill the ksp data
 
+    if (recyclesize_ > 0)                                            // recycle a deflation space between the linear solves
+    {
+      recycler_.reset( new KrylovRecycler(*work_, recyclesize_) );
+      (*recycler_).attach(ksp_, prefix.str());
+    }
+
+    if (ew_)
+    {
+      perr = KSPGetTolerances(ksp_, &ewrtolmin_, PETSC_NULL,         // the requested ksp relative tolerance becomes the lower
+                              PETSC_NULL, PETSC_NULL);               // bound on the adaptive tolerance
+      petsc_err(perr);
+    }
+
     buffer.str(""); buffer << optionpath() << "/type/linear_solver/monitors/view_ksp";
     if (Spud::have_option(buffer.str()))
     {
@@ -596,11 +635,74 @@ void SpudSolverBucket::fill_base_()
   serr = Spud::get_option(buffer.str(), relax_, 1.0);                // types)
   spud_err(buffer.str(), serr);
 
+  buffer.str(""); buffer << optionpath() <<                          // anderson acceleration history depth (only applies to picard
+                          "/type/anderson_acceleration/history_depth";// solver types)
+  serr = Spud::get_option(buffer.str(), andersondepth_, 0);
+  spud_err(buffer.str(), serr);
+
+  buffer.str(""); buffer << optionpath() <<                          // preconditioner reuse policy (only applies to picard solver
+                          "/type/linear_solver/reuse_preconditioner";// types)
+  reusepc_ = Spud::have_option(buffer.str());
+  if (reusepc_)
+  {
+    buffer.str(""); buffer << optionpath() << 
+                "/type/linear_solver/reuse_preconditioner/max_steps";
+    serr = Spud::get_option(buffer.str(), pcmaxsteps_, 0);           // 0 indicates no limit
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << optionpath() << 
+      "/type/linear_solver/reuse_preconditioner/iteration_growth_factor";
+    serr = Spud::get_option(buffer.str(), pcgrowthfactor_, 2.0);
+    spud_err(buffer.str(), serr);
+  }
+
+  buffer.str(""); buffer << optionpath() <<                          // eisenstat-walker adaptive linear solver tolerances (only
+                          "/type/linear_solver/eisenstat_walker";    // applies to picard solver types)
+  ew_ = Spud::have_option(buffer.str());
+  if (ew_)
+  {
+    buffer.str(""); buffer << optionpath() << 
+        "/type/linear_solver/eisenstat_walker/initial_relative_error";
+    serr = Spud::get_option(buffer.str(), ewrtol0_, 0.3);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << optionpath() << 
+        "/type/linear_solver/eisenstat_walker/maximum_relative_error";
+    serr = Spud::get_option(buffer.str(), ewrtolmax_, 0.9);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << optionpath() << 
+                         "/type/linear_solver/eisenstat_walker/gamma";
+    serr = Spud::get_option(buffer.str(), ewgamma_, 1.0);
+    spud_err(buffer.str(), serr);
+
+    buffer.str(""); buffer << optionpath() << 
+                         "/type/linear_solver/eisenstat_walker/alpha";
+    serr = Spud::get_option(buffer.str(), ewalpha_, 0.5*(1.0+std::sqrt(5.0)));
+    spud_err(buffer.str(), serr);
+  }
+
+  buffer.str(""); buffer << optionpath() <<                          // krylov recycling between linear solves (only applies to
+            "/type/linear_solver/iterative_method/recycling/size";   // gmres)
+  serr = Spud::get_option(buffer.str(), recyclesize_, 0);
+  spud_err(buffer.str(), serr);
+
   buffer.str(""); buffer << optionpath() <<                          // maximum number of residual evaluations (only applies to snes
                                   "/type/max_function_evaluations";  // solver types)
   serr = Spud::get_option(buffer.str(), maxfes_, 10000); 
   spud_err(buffer.str(), serr);
 
+  buffer.str(""); buffer << optionpath() <<                          // matrix-free jacobian action (only applies to snes solver
+                                      "/type/matrix_free_jacobian";  // types)
+  matrixfree_ = Spud::have_option(buffer.str());
+  if (matrixfree_)
+  {
+    buffer.str(""); buffer << optionpath() << 
+                         "/type/matrix_free_jacobian/function_error";
+    serr = Spud::get_option(buffer.str(), mffunctionerror_, -1.0);   // negative indicates the petsc default
+    spud_err(buffer.str(), serr);
+  }
+
   buffer.str(""); buffer << optionpath() << 
                                 "/type/ignore_all_solver_failures";
   ignore_failures_ = Spud::have_option(buffer.str());
@@ -838,40 +940,101 @@ void SpudSolverBucket::initialize_tensors_()
   work_.reset( new dolfin::PETScVector(*std::dynamic_pointer_cast<dolfin::PETScVector>((*(*system_).function()).vector())) ); 
   (*work_).zero();
 
-  dolfin::SystemAssembler sysassembler(bilinear_, linear_, 
-                                    (*system_).bcs());
-  sysassembler.keep_diagonal = true;
-  matrix_.reset(new dolfin::PETScMatrix);                            // allocate the matrix
-  sysassembler.assemble(*matrix_);
+  if (andersondepth_ > 0)                                            // allocate the anderson acceleration history
+  {
+    anderson_.reset( new AndersonAccelerator(*work_, andersondepth_, relax_) );
+  }
+
+  systemassemblersetup_ = 0.0;                                       // time the construction of the persistent assemblers (which
+  double starttime;                                                  // reusing them saves every iteration)
+
+  if (matrixfree_)                                                   // matrix-free jacobian action so the jacobian is never
+  {                                                                  // assembled (or allocated)
+    if (type()!="SNES")
+    {
+      tf_err("Matrix-free jacobians are only available for SNES solvers.", "Solver: %s::%s", 
+                                      (*system_).name().c_str(), name().c_str());
+    }
+    if (!bilinearpc_)
+    {
+      tf_err("Matrix-free jacobians require a JacobianPC form to build the preconditioner from.", "Solver: %s::%s", 
+                                      (*system_).name().c_str(), name().c_str());
+    }
+  }
+  else
+  {
+    starttime = MPI_Wtime();
+    systemassembler_.reset( new dolfin::SystemAssembler(bilinear_, linear_,// the system assemblers are kept for the lifetime of
+                                                       (*system_).bcs()) );// the solver so that they (and the bc and sparsity data
+    systemassemblersetup_ += MPI_Wtime() - starttime;
+    (*systemassembler_).keep_diagonal = true;                        // of the tensors they initialize) are reused every iteration
+    matrix_.reset(new dolfin::PETScMatrix);                          // allocate the matrix
+    (*systemassembler_).assemble(*matrix_);
+    if (ident_zeros_)
+    {
+      (*matrix_).ident_zeros();
+    }
+    form_changed(bilinear_);                                         // record the coefficient state the matrix was assembled
+                                                                     // with so an unchanged first iteration isn't reassembled
+  }
 
   if(bilinearpc_)                                                    // do we have a pc form?
   {
-    dolfin::SystemAssembler sysassemblerpc(bilinearpc_, linear_,
-                                           (*system_).bcs());
-    sysassemblerpc.keep_diagonal = true;
+    starttime = MPI_Wtime();
+    systemassemblerpc_.reset( new dolfin::SystemAssembler(bilinearpc_, linear_,
+                                                          (*system_).bcs()) );
+    systemassemblersetup_ += MPI_Wtime() - starttime;
+    (*systemassemblerpc_).keep_diagonal = true;
     matrixpc_.reset(new dolfin::PETScMatrix);                        // allocate the matrix
-    sysassemblerpc.assemble(*matrixpc_);
+    (*systemassemblerpc_).assemble(*matrixpc_);
+    if (ident_zeros_pc_)
+    {
+      (*matrixpc_).ident_zeros();
+    }
+    form_changed(bilinearpc_);                                       // record the coefficient state
+  }
+
+  if (matrixfree_)                                                   // estimate the memory the unassembled jacobian saves from
+  {                                                                  // the pc matrix (the jacobian would share its sparsity as
+    PetscErrorCode perr;                                             // both forms are on the system function space)
+    MatInfo info;
+    perr = MatGetInfo((*matrixpc_).mat(), MAT_GLOBAL_SUM, &info); petsc_err(perr);
+    mfmemorysaved_ = info.memory;
+
+    log(INFO, "Matrix-free jacobian in %s::%s, skipping its assembly saves ~%g MB (~%g nonzeros, estimated from the pc matrix)", 
+                          (*system_).name().c_str(), name().c_str(), 
+                          mfmemorysaved_/1048576.0, (double)info.nz_allocated);
   }
 
   for (Form_const_it f_it = solverforms_begin(); 
                      f_it != solverforms_end(); f_it++)
   {
-    dolfin::SystemAssembler sysassemblerform((*f_it).second, linear_,
-                                             (*system_).bcs());
-    sysassemblerform.keep_diagonal = true;
+    starttime = MPI_Wtime();
+    SystemAssembler_ptr sysassemblerform( new dolfin::SystemAssembler((*f_it).second, linear_,
+                                                                      (*system_).bcs()) );
+    systemassemblersetup_ += MPI_Wtime() - starttime;
+    (*sysassemblerform).keep_diagonal = true;
     PETScMatrix_ptr solvermatrix;
     solvermatrix.reset(new dolfin::PETScMatrix);
-    sysassemblerform.assemble(*solvermatrix);
+    (*sysassemblerform).assemble(*solvermatrix);
+    if (solverident_zeros_[(*f_it).first])
+    {
+      (*solvermatrix).ident_zeros();
+    }
+    form_changed((*f_it).second);                                    // record the coefficient state
     solvermatrices_[(*f_it).first] = solvermatrix;
+    solversystemassemblers_[(*f_it).first] = sysassemblerform;
   }
 
-  dolfin::Assembler assembler;
+  starttime = MPI_Wtime();
+  assembler_.reset( new dolfin::Assembler );
+  assemblersetup_ = MPI_Wtime() - starttime;
    
   rhs_.reset(new dolfin::PETScVector);                               // allocate the rhs
-  assembler.assemble(*rhs_, *linear_);
+  (*assembler_).assemble(*rhs_, *linear_);
 
   res_.reset(new dolfin::PETScVector);                               // allocate the residual
-  assembler.assemble(*res_, *residual_);
+  (*assembler_).assemble(*res_, *residual_);
 
 }
 
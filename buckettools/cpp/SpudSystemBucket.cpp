@@ -30,6 +30,7 @@
 #include "Logger.h"
 #include <dolfin.h>
 #include <string>
+#include <cmath>
 #include <spud>
 
 using namespace buckettools;
@@ -71,10 +72,43 @@ void SpudSystemBucket::fill()
 
   fill_solvers_();                                                   // initialize the nonlinear solvers in this system
 
+  fill_subcycling_();                                                // the subcycling constraint (now the fields and coefficients
+                                                                     // are available)
+
   fill_functionals_();
 
 }
 
+//*******************************************************************|************************************************************//
+// fill in the constraint on the number of substeps (if subcycling with a constraint)
+//*******************************************************************|************************************************************//
+void SpudSystemBucket::fill_subcycling_()
+{
+  std::stringstream buffer;                                          // optionpath buffer
+  Spud::OptionError serr;                                            // spud option error
+
+  buffer.str(""); buffer << optionpath() << "/subcycling/constraint";
+  if (Spud::have_option(buffer.str()))
+  {
+    std::string functionname;
+    if (Spud::have_option(buffer.str()+"/field/name"))
+    {
+      serr = Spud::get_option(buffer.str()+"/field/name", functionname);
+      spud_err(buffer.str()+"/field/name", serr);
+      subcycleconstraint_.first = fetch_field(functionname);
+    }
+    else
+    {
+      serr = Spud::get_option(buffer.str()+"/coefficient/name", functionname);
+      spud_err(buffer.str()+"/coefficient/name", serr);
+      subcycleconstraint_.first = fetch_coeff(functionname);
+    }
+
+    serr = Spud::get_option(buffer.str()+"/requested_maximum_value", subcycleconstraint_.second);
+    spud_err(buffer.str()+"/requested_maximum_value", serr);
+  }
+}
+
 //*******************************************************************|************************************************************//
 // loop over the coefficients and allocate any that are coefficient functions
 //*******************************************************************|************************************************************//
@@ -235,6 +269,27 @@ void SpudSystemBucket::fill_base_()
 
   change_calculated_.reset( new bool(false) );                       // assume the change hasn't been calculated yet
 
+  buffer.str(""); buffer << optionpath() <<                          // order of the initial guess extrapolation across timesteps
+                            "/initial_guess_extrapolation/order";
+  serr = Spud::get_option(buffer.str(), extrapolationorder_, 0); 
+  spud_err(buffer.str(), serr);
+  if (extrapolationorder_ < 0 || extrapolationorder_ > 2)
+  {
+    tf_err("Initial guess extrapolation order must be 1 (linear) or 2 (quadratic).", "System: %s, order: %d", 
+                                                        name_.c_str(), extrapolationorder_);
+  }
+
+  buffer.str(""); buffer << optionpath() <<                          // minimum number of substeps per timestep
+                            "/subcycling/number_substeps";
+  serr = Spud::get_option(buffer.str(), nsubsteps_, 1); 
+  spud_err(buffer.str(), serr);
+  if (nsubsteps_ < 1)
+  {
+    tf_err("Number of substeps must be at least 1.", "System: %s, number_substeps: %d", 
+                                                        name_.c_str(), nsubsteps_);
+  }
+  substeps_ = nsubsteps_;
+
 }
 
 //*******************************************************************|************************************************************//
@@ -279,6 +334,12 @@ void SpudSystemBucket::fill_systemfunction_()
   buffer.str(""); buffer << name() << "::Residual";
   (*residualfunction_).rename( buffer.str(), buffer.str() );
 
+  for (int i = 0; i < extrapolationorder_; i++)                      // previous time levels for the initial guess extrapolation
+  {
+    extrapvecs_.push_back( (*(*function_).vector()).copy() );
+    extraptimes_.push_back( -HUGE_VAL );
+  }
+
   if ((Spud::option_count(optionpath()+"/nonlinear_solver/type::SNES/monitors/visualization")+
        Spud::option_count(optionpath()+"/nonlinear_solver/type::SNES/monitors/convergence_file"))>0)
   {
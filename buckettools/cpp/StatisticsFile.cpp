@@ -34,7 +34,7 @@ using namespace buckettools;
 //*******************************************************************|************************************************************//
 StatisticsFile::StatisticsFile(const std::string &name, 
                                const MPI_Comm &comm, 
-                               const Bucket *bucket) : DiagnosticsFile(name, comm, bucket)
+                               const Bucket *bucket) : DiagnosticsFile(name, comm, bucket, (*bucket).binary_diagnostics())
 {
                                                                      // do nothing... all handled by DiagnosticsFile constructor
 }
@@ -53,7 +53,7 @@ StatisticsFile::~StatisticsFile()
 void StatisticsFile::write_header()
 {
   header_open_();
-  header_constants_();                                               // write constant tags
+  header_constants_(binary_);                                        // write constant tags
   header_timestep_();                                                // write tags for the timesteps
   header_bucket_();                                                  // write tags for the actual bucket variables - fields etc.
   header_close_();
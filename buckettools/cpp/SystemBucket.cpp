@@ -26,15 +26,21 @@
 #include "SolverBucket.h"
 #include "FunctionalBucket.h"
 #include "Logger.h"
+#include "BucketPETScBase.h"
 #include <dolfin.h>
 #include <string>
+#include <algorithm>
+#include <cmath>
 
 using namespace buckettools;
 
 //*******************************************************************|************************************************************//
 // default constructor
 //*******************************************************************|************************************************************//
-SystemBucket::SystemBucket()
+SystemBucket::SystemBucket() : residualnorm_(0.0), residualnorm0_(0.0), inputchange_(0.0), 
+                               skipped_(false), solvecount_(0), extrapolationorder_(0), nextrap_(0), 
+                               oldtime_(-HUGE_VAL), nstates_(0), nsubsteps_(1), 
+                               substeps_(1)
 {
                                                                      // do nothing
 }
@@ -42,7 +48,11 @@ SystemBucket::SystemBucket()
 //*******************************************************************|************************************************************//
 // specific constructor
 //*******************************************************************|************************************************************//
-SystemBucket::SystemBucket(Bucket* bucket) : bucket_(bucket)
+SystemBucket::SystemBucket(Bucket* bucket) : bucket_(bucket), residualnorm_(0.0), 
+                                             residualnorm0_(0.0), inputchange_(0.0), 
+                                             skipped_(false), solvecount_(0), extrapolationorder_(0), 
+                                             nextrap_(0), oldtime_(-HUGE_VAL), nstates_(0), 
+                                             nsubsteps_(1), substeps_(1)
 {
                                                                      // do nothing
 }
@@ -108,6 +118,11 @@ bool SystemBucket::solve(const std::vector<int> &locations, const bool force)
     }
   }
 
+  if (solved)
+  {
+    solvecount_++;
+  }
+
   return solved;
 }
 
@@ -118,6 +133,20 @@ void SystemBucket::update()
 {
   if (function_)
   {
+    const double time = (*bucket_).current_time();
+    if (extrapolationorder_ > 0 && time > oldtime_)                  // the oldfunction is about to become a previous time level
+    {                                                                // so rotate it into the ring (unless this is a repeat update
+      if (oldtime_ > -HUGE_VAL)                                      // at the same time)
+      {
+        std::rotate(extrapvecs_.rbegin(), extrapvecs_.rbegin()+1, extrapvecs_.rend());
+        std::rotate(extraptimes_.rbegin(), extraptimes_.rbegin()+1, extraptimes_.rend());
+        *extrapvecs_[0] = *(*oldfunction_).vector();
+        extraptimes_[0] = oldtime_;
+        nextrap_ = std::min(nextrap_+1, extrapolationorder_);
+      }
+    }
+    oldtime_ = time;
+
     (*(*oldfunction_).vector()) = (*(*function_).vector());          // update the oldfunction to the new function value
   }
   
@@ -141,6 +170,11 @@ void SystemBucket::update()
     (*(*f_it).second).update();
   }
 
+  if (nextrap_ > 0)                                                  // seed the next timestep with an extrapolated initial guess
+  {
+    extrapolate_();
+  }
+
   resetcalculated();                                                 // NOTE: this must be done LAST as some functionals may
                                                                      // actually be calculated by this routine to ensure any steady 
                                                                      // state check that uses them is accurate
@@ -323,6 +357,7 @@ double SystemBucket::residual_norm(const std::vector<int> &locations)
     if (calculate_norm)
     {
       norm = (*(*s_it).second).residual_norm();
+      residualnorm_ = norm;
 
       (*(*residualfunction_).vector()) = (*std::dynamic_pointer_cast< dolfin::GenericVector >((*(*s_it).second).residual_vector()));
     }
@@ -347,6 +382,327 @@ const std::vector<int> SystemBucket::solve_locations() const
   return locations;
 }
 
+//*******************************************************************|************************************************************//
+// return a boolean indicating if the given function is the current or iterated function of this system or one of its fields
+// (the old functions are not included as they don't change within a timestep)
+//*******************************************************************|************************************************************//
+const bool SystemBucket::owns_function(const dolfin::GenericFunction* function) const
+{
+  if (!function_)
+  {
+    return false;
+  }
+
+  if (function == &(*function_) || function == &(*iteratedfunction_))
+  {
+    return true;
+  }
+
+  for (FunctionBucket_const_it f_it = fields_begin(); 
+                               f_it != fields_end(); f_it++)
+  {
+    if (function == &(*(*(*f_it).second).function()) || 
+        function == &(*(*(*f_it).second).iteratedfunction()))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//*******************************************************************|************************************************************//
+// return a boolean indicating if any of the solvers in this system depend on the current or iterated solution of the given system
+// (conservatively true if any solver depends on coefficients whose dependencies are unknown)
+//*******************************************************************|************************************************************//
+const bool SystemBucket::depends_on(const SystemBucket &system)
+{
+  if (&system == this || system.fields_size() == 0)
+  {
+    return false;
+  }
+
+  for (SolverBucket_it s_it = solvers_begin(); 
+                       s_it != solvers_end(); s_it++)
+  {
+    if ((*(*s_it).second).unknown_dependencies())
+    {
+      return true;
+    }
+
+    const std::set< const dolfin::GenericFunction* > &dependencies = 
+                                       (*(*s_it).second).dependencies();
+    for (std::set< const dolfin::GenericFunction* >::const_iterator d_it = dependencies.begin();
+                                                               d_it != dependencies.end(); d_it++)
+    {
+      if (system.owns_function(*d_it))
+      {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+//*******************************************************************|************************************************************//
+// reset the solve tracking at the start of the nonlinear systems iterations of a timestep (taking the latest residual norm as the
+// reference for relative tolerances)
+//*******************************************************************|************************************************************//
+void SystemBucket::start_iterating()
+{
+  residualnorm0_ = residualnorm_;
+  inputchange_ = 0.0;
+  skipped_ = false;
+  solvecount_ = 0;
+}
+
+//*******************************************************************|************************************************************//
+// return the l2 norm of the change in the iterated function over the latest iteration relative to the l2 norm of the iterated
+// function
+//*******************************************************************|************************************************************//
+const double SystemBucket::iterated_change() const
+{
+  if (!function_)
+  {
+    return 0.0;
+  }
+
+  const double norm = (*(*iteratedfunction_).vector()).norm("l2");
+  dolfin::PETScVector change(*std::dynamic_pointer_cast<dolfin::PETScVector>((*iteratedfunction_).vector()));
+  change -= (*(*olditeratedfunction_).vector());
+  const double changenorm = change.norm("l2");
+
+  if (norm > 0.0)
+  {
+    return changenorm/norm;
+  }
+  return changenorm;
+}
+
+//*******************************************************************|************************************************************//
+// store the function and oldfunction values at the start of a timestep so that it can be rolled back, shifting the previously
+// stored oldfunction down a time level for the error estimate
+//*******************************************************************|************************************************************//
+void SystemBucket::store_state()
+{
+  if (!function_)
+  {
+    return;
+  }
+
+  if (statevecs_.empty())                                            // allocate the state (and work) vectors on the first call
+  {
+    for (uint i = 0; i < 3; i++)
+    {
+      statevecs_.push_back( (*(*function_).vector()).copy() );
+    }
+    errorvec_ = (*(*function_).vector()).copy();
+    weightvec_ = (*(*function_).vector()).copy();
+  }
+  else
+  {
+    *statevecs_[2] = *statevecs_[1];
+  }
+  nstates_ = std::min(nstates_+1, 2);
+
+  *statevecs_[0] = *(*function_).vector();
+  *statevecs_[1] = *(*oldfunction_).vector();
+}
+
+//*******************************************************************|************************************************************//
+// restore the function values stored at the start of the timestep (including the iterated functions, which are reset to the
+// initial guess of the timestep)
+//*******************************************************************|************************************************************//
+void SystemBucket::restore_state()
+{
+  if (nstates_ > 0)
+  {
+    (*(*function_).vector()) = *statevecs_[0];
+    (*(*iteratedfunction_).vector()) = *statevecs_[0];
+    (*(*olditeratedfunction_).vector()) = *statevecs_[0];
+    (*(*oldfunction_).vector()) = *statevecs_[1];
+  }
+
+  resetcalculated();
+}
+
+//*******************************************************************|************************************************************//
+// return the root mean square of the difference between the function and its prediction from the previous two time levels:
+//   p = u_n + ratio*(u_n - u_{n-1})
+// weighted by atol + rtol*|u| (so that a value greater than 1 indicates the timestep was too inaccurate), where ratio is the ratio
+// of the latest timestep to the previous one
+// returns a negative value if not enough time levels are available to make the estimate
+//*******************************************************************|************************************************************//
+const double SystemBucket::error_norm(const double &ratio, const double &rtol, 
+                                      const double &atol)
+{
+  if (nstates_ < 2)
+  {
+    return -1.0;
+  }
+
+  PetscErrorCode perr;
+
+  const dolfin::GenericVector &u = *(*function_).vector();
+  (*errorvec_) = u;
+  (*errorvec_).axpy(-(1.0+ratio), *statevecs_[1]);
+  (*errorvec_).axpy(ratio, *statevecs_[2]);                          // e = u - p
+
+  (*weightvec_) = u;
+  Vec e = dolfin::as_type<dolfin::PETScVector>(*errorvec_).vec();
+  Vec w = dolfin::as_type<dolfin::PETScVector>(*weightvec_).vec();
+  perr = VecAbs(w); petsc_err(perr);
+  perr = VecScale(w, rtol); petsc_err(perr);
+  perr = VecShift(w, atol); petsc_err(perr);                         // w = atol + rtol*|u|
+  perr = VecPointwiseDivide(e, e, w); petsc_err(perr);
+
+  return (*errorvec_).norm("l2")/std::sqrt((double)(*errorvec_).size());
+}
+
+//*******************************************************************|************************************************************//
+// set whether the solvers in this system should record failures (rather than terminate the simulation)
+//*******************************************************************|************************************************************//
+void SystemBucket::recoverable_failures(const bool &recoverable)
+{
+  for (SolverBucket_it s_it = solvers_begin(); s_it != solvers_end(); s_it++)
+  {
+    (*(*s_it).second).recoverable_failures(recoverable);
+  }
+}
+
+//*******************************************************************|************************************************************//
+// return true if any of the solvers in this system have recorded a failure
+//*******************************************************************|************************************************************//
+const bool SystemBucket::failed() const
+{
+  for (SolverBucket_const_it s_it = solvers_begin(); s_it != solvers_end(); s_it++)
+  {
+    if ((*(*s_it).second).failed())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//*******************************************************************|************************************************************//
+// forget any failures recorded by the solvers in this system
+//*******************************************************************|************************************************************//
+void SystemBucket::reset_failed()
+{
+  for (SolverBucket_it s_it = solvers_begin(); s_it != solvers_end(); s_it++)
+  {
+    (*(*s_it).second).reset_failed();
+  }
+}
+
+//*******************************************************************|************************************************************//
+// update the number of substeps for the next timestep from the subcycling constraint (evaluated using the global timestep)
+//*******************************************************************|************************************************************//
+void SystemBucket::update_substeps()
+{
+  substeps_ = nsubsteps_;
+
+  if (subcycleconstraint_.first)
+  {
+    (*subcycleconstraint_.first).refresh(true);
+    const double maxval = (*subcycleconstraint_.first).norm("iterated", "linf");
+    if (maxval > 0.0)
+    {
+      substeps_ = std::max(substeps_, (int)std::ceil(maxval/subcycleconstraint_.second));
+    }
+  }
+
+  if (substeps_ > 1)
+  {
+    log(INFO, "Subcycling %s with %d substeps", name().c_str(), substeps_);
+  }
+}
+
+//*******************************************************************|************************************************************//
+// store the iterated and old functions so that they can be interpolated in time while a system that depends on them is subcycled
+//*******************************************************************|************************************************************//
+void SystemBucket::begin_interpolation()
+{
+  if (!function_)
+  {
+    return;
+  }
+
+  if (interpvecs_.empty())                                           // allocate the stored vectors on the first call
+  {
+    interpvecs_.push_back( (*(*oldfunction_).vector()).copy() );
+    interpvecs_.push_back( (*(*iteratedfunction_).vector()).copy() );
+  }
+  else
+  {
+    *interpvecs_[0] = *(*oldfunction_).vector();
+    *interpvecs_[1] = *(*iteratedfunction_).vector();
+  }
+}
+
+//*******************************************************************|************************************************************//
+// set the old and iterated functions to the linear interpolants of the stored old and iterated values at the given fractions of
+// the timestep
+//*******************************************************************|************************************************************//
+void SystemBucket::interpolate(const double &oldfraction, const double &fraction)
+{
+  if (interpvecs_.empty())
+  {
+    return;
+  }
+
+  dolfin::GenericVector &old = *(*oldfunction_).vector();
+  old = *interpvecs_[0];
+  old *= (1.0-oldfraction);
+  old.axpy(oldfraction, *interpvecs_[1]);
+
+  dolfin::GenericVector &iterated = *(*iteratedfunction_).vector();
+  iterated = *interpvecs_[0];
+  iterated *= (1.0-fraction);
+  iterated.axpy(fraction, *interpvecs_[1]);
+}
+
+//*******************************************************************|************************************************************//
+// restore the old and iterated functions stored by begin_interpolation
+//*******************************************************************|************************************************************//
+void SystemBucket::end_interpolation()
+{
+  if (interpvecs_.empty())
+  {
+    return;
+  }
+
+  (*(*oldfunction_).vector()) = *interpvecs_[0];
+  (*(*iteratedfunction_).vector()) = *interpvecs_[1];
+}
+
+//*******************************************************************|************************************************************//
+// advance a subcycled system to its next substep, making the latest solution the old function
+//*******************************************************************|************************************************************//
+void SystemBucket::advance_substep()
+{
+  if (function_)
+  {
+    (*(*oldfunction_).vector()) = (*(*function_).vector());
+  }
+}
+
+//*******************************************************************|************************************************************//
+// restore the old function of a subcycled system to its value at the start of the timestep (leaving the function and iterated
+// function at the end of the final substep)
+//*******************************************************************|************************************************************//
+void SystemBucket::end_substeps()
+{
+  if (interpvecs_.empty())
+  {
+    return;
+  }
+
+  (*(*oldfunction_).vector()) = *interpvecs_[0];
+}
+
 //*******************************************************************|************************************************************//
 // return a boolean indicating if all the relevant solvers in this system have been solved or not
 //*******************************************************************|************************************************************//
@@ -1053,6 +1409,43 @@ void SystemBucket::apply_ic_()
   (*(*function_).vector()) = (*(*oldfunction_).vector());            // set the function vector to the old function vector
 }
 
+//*******************************************************************|************************************************************//
+// extrapolate the system function to the next time level using the (lagrange) polynomial through the current function and the
+// stored previous time levels, setting the function, iterated and old iterated functions to the result as the initial guess for
+// the next solve (the previous time levels are not assumed to be evenly spaced)
+//*******************************************************************|************************************************************//
+void SystemBucket::extrapolate_()
+{
+  const double newtime = (*bucket_).current_time() + (*bucket_).timestep();
+
+  std::vector<double> times(1, oldtime_);                            // oldfunction now holds the latest time level
+  times.insert(times.end(), extraptimes_.begin(), extraptimes_.begin()+nextrap_);
+
+  std::vector<double> weights(times.size(), 1.0);
+  for (std::size_t j = 0; j < times.size(); j++)
+  {
+    for (std::size_t i = 0; i < times.size(); i++)
+    {
+      if (i != j)
+      {
+        weights[j] *= (newtime - times[i])/(times[j] - times[i]);
+      }
+    }
+  }
+
+  dolfin::GenericVector &guess = *(*function_).vector();
+  guess = *(*oldfunction_).vector();
+  guess *= weights[0];
+  for (std::size_t j = 1; j < times.size(); j++)
+  {
+    guess.axpy(weights[j], *extrapvecs_[j-1]);
+  }
+  (*(*iteratedfunction_).vector()) = guess;
+  (*(*olditeratedfunction_).vector()) = guess;
+
+  log(DBG, "  Extrapolated initial guess for %s from %d time levels", name().c_str(), (int)times.size());
+}
+
 //*******************************************************************|************************************************************//
 // apply the vector of system boundary conditions to the system function vectors to ensure consisten initial and boundary conditions
 //*******************************************************************|************************************************************//
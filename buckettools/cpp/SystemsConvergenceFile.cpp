@@ -38,7 +38,7 @@ using namespace buckettools;
 SystemsConvergenceFile::SystemsConvergenceFile(const std::string &name, 
                                        const MPI_Comm &comm, 
                                        const Bucket *bucket) :
-                                        DiagnosticsFile(name, comm, bucket)
+                                        DiagnosticsFile(name, comm, bucket, (*bucket).binary_diagnostics())
 {
                                                                      // do nothing... all handled by DiagnosticsFile constructor
 }
@@ -57,7 +57,7 @@ SystemsConvergenceFile::~SystemsConvergenceFile()
 void SystemsConvergenceFile::write_header()
 {
   header_open_();
-  header_constants_();                                               // write constant tags
+  header_constants_(binary_);                                        // write constant tags
   header_timestep_();                                                // write tags for the timesteps
   header_iteration_();                                               // write tags for the iterations
   header_bucket_();                                                  // write tags for the actual bucket variables - fields etc.
@@ -128,6 +128,7 @@ void SystemsConvergenceFile::header_system_(const SystemBucket_ptr sys_ptr)
   tag_((*sys_ptr).name(), "res_min");
   tag_((*sys_ptr).name(), "res_norm(l2)");
   tag_((*sys_ptr).name(), "res_norm(inf)");
+  tag_((*sys_ptr).name(), "solves");
 }
 
 //*******************************************************************|************************************************************//
@@ -216,6 +217,7 @@ void SystemsConvergenceFile::data_system_(const SystemBucket_ptr sys_ptr)
   values.push_back((*(*(*sys_ptr).residualfunction()).vector()).min());
   values.push_back((*(*(*sys_ptr).residualfunction()).vector()).norm("l2"));
   values.push_back((*(*(*sys_ptr).residualfunction()).vector()).norm("linf"));
+  values.push_back((double)(*sys_ptr).solve_count());                // solves this timestep
 
   data_(values);
 }
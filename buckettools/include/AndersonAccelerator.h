@@ -0,0 +1,111 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef __ANDERSONACCELERATOR_H
+#define __ANDERSONACCELERATOR_H
+
+#include "BoostTypes.h"
+#include <dolfin.h>
+#include "petscvec.h"
+
+namespace buckettools
+{
+
+  //*****************************************************************|************************************************************//
+  // AndersonAccelerator class:
+  //
+  // The AndersonAccelerator class implements Anderson (or DIIS) acceleration of a fixed point iteration x_{k+1} = G(x_k).
+  // Given the input x_k and output G(x_k) of each iteration it returns the combination of the most recent iterates that
+  // minimizes the l2 norm of the fixed point residual G(x)-x.  The differences between successive residuals and outputs are
+  // stored in fixed size rings of petsc vectors.
+  //*****************************************************************|************************************************************//
+  class AndersonAccelerator
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:                                                            // available to everyone
+
+    //***************************************************************|***********************************************************//
+    // Constructors and destructors
+    //***************************************************************|***********************************************************//
+
+    AndersonAccelerator(const dolfin::PETScVector &vector,           // specific constructor (vector provides the layout)
+                        const int &depth,
+                        const double &beta=1.0);
+
+    ~AndersonAccelerator();                                          // default destructor
+
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    void reset();                                                    // forget the stored history (e.g. at the start of a solve)
+
+    void update(dolfin::GenericVector &x,                            // overwrite x (the input to the last iteration) with the
+                const dolfin::GenericVector &g);                     // accelerated next iterate given g, the iteration output
+
+    //***************************************************************|***********************************************************//
+    // Base data access
+    //***************************************************************|***********************************************************//
+
+    const int depth() const                                          // return the maximum history depth
+    { return depth_; }
+
+    const int history_size() const                                   // return the number of stored history vectors
+    { return nstored_; }
+
+  //*****************************************************************|***********************************************************//
+  // Private functions
+  //*****************************************************************|***********************************************************//
+
+  private:                                                           // only available to this class
+
+    //***************************************************************|***********************************************************//
+    // Base data
+    //***************************************************************|***********************************************************//
+
+    int depth_;                                                      // maximum number of history vectors
+
+    double beta_;                                                    // mixing parameter
+
+    Vec *df_, *dg_;                                                  // rings of residual and output differences
+
+    Vec f_, fold_, gold_;                                            // current and previous residuals and previous output
+
+    int nstored_, head_;                                             // number of stored differences and the next ring position
+
+    bool havelast_;                                                  // do we have a previous residual and output stored
+
+    //***************************************************************|***********************************************************//
+    // Filling data
+    //***************************************************************|***********************************************************//
+
+    bool solve_leastsquares_(std::vector<PetscScalar> &gamma);       // solve the least squares problem for the coefficients
+
+  };
+
+  typedef std::shared_ptr< AndersonAccelerator > AndersonAccelerator_ptr;// define a (boost shared) pointer to this class type
+
+}
+#endif
@@ -0,0 +1,112 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef __BATCH_RECORDER_H
+#define __BATCH_RECORDER_H
+
+#include <dolfin.h>
+#include <vector>
+
+namespace buckettools
+{
+
+  //*****************************************************************|************************************************************//
+  // BatchRecorder class:
+  //
+  // A dolfin Expression used to find the points at which a finite element evaluates its degrees of freedom.  When recording it
+  // stores the points it is evaluated at (returning zeros), when replaying it returns the given values in the same order.
+  //*****************************************************************|************************************************************//
+  class BatchRecorder : public dolfin::Expression
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:                                                            // available to everyone
+
+    BatchRecorder(const std::vector< std::size_t > &value_shape) : 
+                                     dolfin::Expression(value_shape), 
+                                     npoints_(0), replaying_(false), 
+                                     next_(0)
+    {}
+
+    void eval(dolfin::Array<double>& values, 
+              const dolfin::Array<double>& x) const
+    {
+      if (replaying_)
+      {
+        for (std::size_t i = 0; i < values.size(); i++)
+        {
+          values[i] = (*replayvalues_)[next_++];
+        }
+      }
+      else
+      {
+        points_.insert(points_.end(), x.data(), x.data()+x.size());
+        npoints_++;
+        for (std::size_t i = 0; i < values.size(); i++)
+        {
+          values[i] = 0.0;
+        }
+      }
+    }
+
+    void record()                                                    // start recording (forgetting any recorded points)
+    {
+      points_.clear();
+      npoints_ = 0;
+      replaying_ = false;
+    }
+
+    void replay(const std::vector<double> &values)                   // start replaying the given values
+    {
+      replayvalues_ = &values;
+      next_ = 0;
+      replaying_ = true;
+    }
+
+    const std::vector<double>& points() const                        // return the recorded points (point major, npoints*dim)
+    { return points_; }
+
+    const std::size_t npoints() const                                // return the number of recorded points
+    { return npoints_; }
+
+  //*****************************************************************|***********************************************************//
+  // Private functions
+  //*****************************************************************|***********************************************************//
+
+  private:                                                           // only available to this class
+
+    mutable std::vector<double> points_;
+
+    mutable std::size_t npoints_;
+
+    bool replaying_;
+
+    const std::vector<double> *replayvalues_;
+
+    mutable std::size_t next_;
+
+  };
+}
+
+#endif
@@ -87,6 +87,8 @@ namespace buckettools {
   typedef std::shared_ptr< dolfin::Array<double> >                Array_double_ptr;
   typedef std::shared_ptr< dolfin::SubDomain >                    SubDomain_ptr;
   typedef std::shared_ptr< dolfin::FunctionAssigner >             FunctionAssigner_ptr;
+  typedef std::shared_ptr< dolfin::Assembler >                    Assembler_ptr;
+  typedef std::shared_ptr< dolfin::SystemAssembler >              SystemAssembler_ptr;
 
   //*****************************************************************|************************************************************//
   // iterators to std shared pointers in map pointer structures
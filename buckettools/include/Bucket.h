@@ -30,6 +30,7 @@
 #include "SolverBucket.h"
 #include "DetectorsFile.h"
 #include "SystemsConvergenceFile.h"
+#include "AndersonAccelerator.h"
 #include <dolfin.h>
 #include <boost/timer/timer.hpp>
 
@@ -90,6 +91,8 @@ namespace buckettools
 
     void update_timedependent();                                     // update the potentially timedependent functions in the systems in this bucket
 
+    void advect_detectors();                                         // move the (lagrangian) detectors through the last timestep
+
     bool complete();                                                 // indicate if the simulation is complete or not
 
     bool complete_timestepping();                                    // indicate if timestepping is complete or not
@@ -144,6 +147,9 @@ namespace buckettools
     const double relaxation_parameter() const                        // return the relaxation parameter
     { return relax_; }
 
+    const int anderson_depth() const                                 // return the anderson acceleration history depth (0 if off)
+    { return andersondepth_; }
+
     const std::string output_basename() const                        // return the output base name
     { return output_basename_; }
 
@@ -291,6 +297,9 @@ namespace buckettools
     const bool write_vischeckpoints() const                          // return if we're visualizing using checkpoint format or not
     { return write_vischeckpoints_; }
 
+    const bool binary_diagnostics() const                            // return if diagnostic data rows are written in binary or not
+    { return binary_diagnostics_; }
+
     void output(const int &location);                                // output diagnostics for the bucket
 
     void checkpoint(const int &location);                            // work out if we're checkpointing the bucket
@@ -335,6 +344,14 @@ namespace buckettools
     std::vector< std::pair< FunctionBucket_ptr, double > >           // constraints on the timestep in < FunctionBucket_ptr, max value > pairs
                                               timestep_constraints_;
 
+    double_ptr timestep_errortol_;                                   // relative error tolerance of the error controlled timestep
+                                                                     // (null if the timestep isn't error controlled)
+
+    double timestep_erroratol_, timestep_safety_, timestep_minimum_; // absolute error tolerance, safety factor and minimum timestep
+                                                                     // of the error controlled timestep
+
+    int timestep_maxrejections_;                                     // maximum number of consecutive timestep rejections
+
     int_ptr iteration_count_;                                        // the number of iterations requested and the number of nonlinear 
                                                                      // iterations taken
     int minits_, maxits_;                                            // nonlinear system iteration counts
@@ -343,6 +360,18 @@ namespace buckettools
 
     double relax_;                                                   // relaxation parameter
 
+    int andersondepth_;                                              // anderson acceleration history depth (0 if not accelerated)
+
+    AndersonAccelerator_ptr anderson_;                               // anderson acceleration of the nonlinear systems iterations
+
+    PETScVector_ptr andersonx_, andersong_;                          // the stacked input and output iterates of all the systems
+                                                                     // (accelerated together as one coupled iteration)
+
+    bool lazysolves_;                                                // skip the solves of converged systems whose inputs haven't
+                                                                     // changed in the nonlinear systems iterations
+
+    double lazychangetol_;                                           // input change below which a converged system is skipped
+
     bool ignore_failures_;                                           // ignore convergence failures of the nonlinear systems
 
     double_ptr steadystate_tol_;                                     // the steady state tolerance
@@ -350,6 +379,8 @@ namespace buckettools
     std::string output_basename_;                                    // the output base name
 
     bool write_vischeckpoints_;                                      // whether to write visualization checkpoints or not
+
+    bool binary_diagnostics_;                                        // whether to write diagnostic data rows in binary or not
     
     double_ptr visualization_period_, statistics_period_,            // dump periods
                steadystate_period_, detectors_period_,
@@ -384,6 +415,12 @@ namespace buckettools
 
     ordered_map<const std::string, SystemBucket_ptr> systems_;             // a map from system names to (std shared) pointers to systems
 
+    std::map< const SystemBucket*, std::vector< SystemBucket_ptr > > // the systems that depend on each system
+                                                  systemdependents_;
+
+    std::map< const SystemBucket*, std::vector< SystemBucket_ptr > > // the systems each system depends on
+                                                  systemdependencies_;
+
     ordered_map<const std::string, GenericDetectors_ptr> detectors_;        // a map from detector set name to (std shared) pointers to detectors
 
     //***************************************************************|***********************************************************//
@@ -408,6 +445,10 @@ namespace buckettools
 
     void fill_uflsymbols_();                                         // fill the ufl symbol data structures
 
+    void fill_systemdependencies_();                                 // find which systems depend on each other
+
+    void fill_anderson_();                                           // allocate the anderson acceleration of the nonlinear systems
+
   //*****************************************************************|***********************************************************//
   // Private functions
   //*****************************************************************|***********************************************************//
@@ -424,6 +465,17 @@ namespace buckettools
 
     static boost::timer::cpu_timer timer_;                           // timer from the start of the simulation (init)
 
+    int timestep_rejections_;                                        // number of consecutive rejections of the current timestep
+
+    double timestep_errorold_, timestep_errordt_;                    // error estimate of the last accepted timestep and the
+                                                                     // timestep it proposed
+
+    double oldtimestep_;                                             // the last accepted timestep
+
+    double stateoldtime_;                                            // the old time at the start of the current timestep
+
+    bool iterationsfailed_;                                          // the nonlinear systems iterations failed to converge
+
     //***************************************************************|***********************************************************//
     // Pointers data (continued)
     //***************************************************************|***********************************************************//
@@ -449,11 +501,24 @@ namespace buckettools
     void solve_at_start_();                                          // solve the solvers in this system (in order at the start of a
                                                                      // simulation)
 
+    void store_state_();                                             // store the state at the start of a timestep (if the timestep
+                                                                     // is error controlled)
+
+    bool accept_timestep_();                                         // decide whether to accept the latest timestep (adjusting the
+                                                                     // timestep accordingly)
+
+    void rollback_timestep_();                                       // roll back a rejected timestep
+
+    bool solve_system_(SystemBucket_ptr system, const int &location);// solve a system (in substeps if it's subcycled)
+
     void solve_in_timeloop_();                                       // solve the solvers in this system (in order during the
                                                                      // timeloop of a simulation)
 
     bool complete_iterating_(const double &aerror0);                 // indicate if nonlinear systems iterations are complete or not
 
+    void solve_lazily_(const int &location, const bool skip);        // solve the systems tracking the changes in their inputs
+                                                                     // (and skipping converged systems if requested)
+
     //***************************************************************|***********************************************************//
     // Output functions (continued)
     //***************************************************************|***********************************************************//
@@ -115,6 +115,10 @@ namespace buckettools
     
     void data_func_(const FunctionBucket_ptr f_ptr);
 
+    void data_value_(const double &value, const bool &write);        // add a value to the row of this process (parallel only)
+
+    void data_row_();                                                // write the row collectively (parallel only)
+
     //***************************************************************|***********************************************************//
     // Private members
     //***************************************************************|***********************************************************//
@@ -122,10 +126,24 @@ namespace buckettools
 #ifdef HAS_MPI
     MPI_File mpifile_;
 
-    MPI_Offset mpiwritelocation_;
+    MPI_Datatype mpifiletype_;                                       // file view of the columns this process writes in each row
+
+    bool mpihaveview_;                                               // has the file view been set
 #endif
     
-    uint mpiwritecount_;
+    uint mpiwritecount_;                                             // number of rows written
+
+    uint mpiviewcount_;                                              // number of rows written when the file view was last set
+
+    uint mpiwritecolumn_;                                            // current column in the row being assembled
+
+    std::vector< int > rowcolumns_, viewcolumns_;                    // columns this process writes in the current row and in the
+                                                                     // current file view
+    std::vector< double > rowvalues_, sendvalues_;                   // values this process writes in the current row (in the order
+                                                                     // they were added and in the order of the file view)
+    std::vector< std::size_t > vieworder_;                           // permutation from the added order to the file view order
+
+    std::vector< double > values_;                                   // buffer for the detector values (reused between functions)
 
   };
   
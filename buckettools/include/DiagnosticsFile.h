@@ -55,7 +55,8 @@ namespace buckettools
 
     DiagnosticsFile(const std::string &name, 
                     const MPI_Comm &comm, 
-                    const Bucket *bucket);  // specific constructor
+                    const Bucket *bucket,
+                    const bool &binary=false);                       // specific constructor
     
     virtual ~DiagnosticsFile();                                      // default destructor
     
@@ -77,6 +78,10 @@ namespace buckettools
 
     std::ofstream file_;                                             // file stream
 
+    std::ofstream datfile_;                                          // binary data file stream (name_.dat, if binary_)
+
+    bool binary_;                                                    // write the data rows in binary to datfile_
+
     std::string name_;                                               // file name
 
     const Bucket *bucket_;                                           // a pointer to the bucket
@@ -121,6 +126,9 @@ namespace buckettools
     void data_(const double &value);                                 // write generic data to the file
 
     void data_(const std::vector<double> &values);                   // write generic data to the file
+
+    void data_binary_(const double *values,                          // write little-endian doubles to the binary data file
+                      const uint &nvalues);
     
   };
   
@@ -0,0 +1,55 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __EXPRESSION_DEPENDENCE_H
+#define __EXPRESSION_DEPENDENCE_H
+
+namespace buckettools
+{
+
+  //*****************************************************************|************************************************************//
+  // ExpressionDependence class:
+  //
+  // An interface for expressions that can report what they depend on, so that coefficients interpolated from them are only
+  // reinterpolated when necessary.  Expressions that do not derive from this class are assumed to depend on anything.
+  //*****************************************************************|************************************************************//
+  class ExpressionDependence
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:                                                            // available to everyone
+
+    virtual ~ExpressionDependence()                                  // default destructor
+    {}
+
+    virtual const bool time_dependent() const = 0;                   // return if the expression depends on time
+
+    virtual const bool time_only() const = 0;                        // return if the expression only depends on position and time
+                                                                     // (so only needs reinterpolating when the time changes)
+
+  };
+
+}
+
+#endif
+
@@ -196,6 +196,9 @@ namespace buckettools
                                                                      // so it will be necessary to make a deep copy to access
                                                                      // the vector
 
+    const Form_ptr constant_functional() const                       // return a constant (std shared) pointer to the functional
+    { return constantfunctional_; }                                  // used to set a constant coefficient (null if none)
+
     const Expression_ptr icexpression() const                        // return a constant (std shared) pointer to the initial
     { return icexpression_; }                                        // condition expression for this function
 
@@ -344,6 +347,10 @@ namespace buckettools
 
     Expression_ptr coefficientfunction_;                             // an expression used to set the values of a coefficient function
 
+    bool coefficienttimeonly_;                                       // the coefficient expression only depends on position and time
+
+    double coefficienttime_;                                         // the time the coefficient expression was last interpolated at
+
     Form_ptr constantfunctional_;                                    // a functional that can be used to set a constant function
     
     double_ptr change_;                                              // change in the function in a norm
@@ -379,6 +386,13 @@ namespace buckettools
     //***************************************************************|***********************************************************//
 
     void fill_is_();                                                 // fill the index sets for this function's components
+
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model (continued)
+    //***************************************************************|***********************************************************//
+
+    void interpolate_(dolfin::Function &function,                    // interpolate an expression into a function (in batches if
+                      const dolfin::Expression &expression) const;   // it's a vectorized python, semi-lagrangian or regions expression)
  
     //***************************************************************|***********************************************************//
     // Output functions (continued)
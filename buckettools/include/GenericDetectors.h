@@ -57,13 +57,15 @@ namespace buckettools
     // Detector evaluation
     //***************************************************************|***********************************************************//
 
-    void eval(std::vector< Array_double_ptr > &values,               // base eval implementation, take values of a function at
-              const dolfin::GenericFunction &function,               // detector positions and returns values
-              Mesh_ptr mesh);                                   
+    void eval(std::vector< double > &values,                         // base eval implementation, take values of a function at
+              const dolfin::GenericFunction &function,               // the detector positions owned by this process and return
+              Mesh_ptr mesh);                                        // them component by component (value_size x owned detectors)
 
     void eval_ownership(Mesh_ptr mesh);                              // evaluate and store the cell and detector ownership of 
                                                                      // detectors on a mesh
 
+    virtual void advect();                                           // move the detectors (only lagrangian detectors move)
+
     //***************************************************************|***********************************************************//
     // Base data access
     //***************************************************************|***********************************************************//
@@ -77,9 +79,9 @@ namespace buckettools
     const uint size() const                                          // return the number of detectors in this set
     { return number_detectors_; }
 
-    const std::vector<int> cell_ids(Mesh_ptr mesh);                  // return the cell ids
+    const std::vector<int>& cell_ids(Mesh_ptr mesh);                 // return the cell ids
 
-    const std::vector<int> detector_ids(Mesh_ptr mesh);              // return the detector ids (owned by this process)
+    const std::vector<int>& detector_ids(Mesh_ptr mesh);             // return the detector ids (owned by this process)
 
     //***************************************************************|***********************************************************//
     // Data array access
@@ -116,7 +118,18 @@ namespace buckettools
 
     std::map< Mesh_ptr, std::vector< int > > cell_ids_;              // the cell ids for a particular mesh - not initialized until eval is called
     std::map< Mesh_ptr, std::vector< int > > detector_ids_;          // the detectors ids that this process owns - not initialized until eval is called
+    std::map< Mesh_ptr, std::vector< ufc::cell > > ufc_cells_;       // the cell data of the owned detectors - not initialized until eval is called
+
+    std::vector< double > point_values_;                             // work array for the values at a single detector
     
+    //***************************************************************|***********************************************************//
+    // Filling data
+    //***************************************************************|***********************************************************//
+
+    void set_ownership_(Mesh_ptr mesh,                               // record the cells and detectors owned by this process on a
+                        const std::vector< int > &cellids,           // mesh (and cache the cell data)
+                        const std::vector< int > &detectorids);
+
     //***************************************************************|***********************************************************//
     // Emptying data
     //***************************************************************|***********************************************************//
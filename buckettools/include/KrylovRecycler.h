@@ -0,0 +1,147 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef __KRYLOVRECYCLER_H
+#define __KRYLOVRECYCLER_H
+
+#include "BoostTypes.h"
+#include <dolfin.h>
+#include "petscksp.h"
+
+namespace buckettools
+{
+
+  //*****************************************************************|************************************************************//
+  // KrylovRecycler class:
+  //
+  // The KrylovRecycler class recycles an approximate invariant subspace W between the linear solves of a (gmres) ksp.  After each
+  // solve the harmonic Ritz vectors associated with the smallest harmonic Ritz values of the last gmres cycle are added to W (until
+  // it is full).  W is then applied as a deflation space in the following solves by wrapping the ksp preconditioner M in a shell
+  // preconditioner
+  //   B = W E^{-1} W^T + M^{-1} (I - A W E^{-1} W^T),   E = W^T A W
+  // so that B A W = W, i.e. the recycled modes are mapped to unit eigenvalues of the preconditioned operator in every iteration.
+  //*****************************************************************|************************************************************//
+  class KrylovRecycler
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:                                                            // available to everyone
+
+    //***************************************************************|***********************************************************//
+    // Constructors and destructors
+    //***************************************************************|***********************************************************//
+
+    KrylovRecycler(const dolfin::PETScVector &vector,                // specific constructor (vector provides the layout)
+                   const int &size);
+
+    ~KrylovRecycler();                                               // default destructor
+
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    void attach(KSP &ksp, const std::string &name);                  // attach the recycler to a ksp (wrapping its pc and through
+                                                                     // pre and post solves)
+
+    PetscErrorCode project(KSP ksp, Vec b, Vec x);                   // project the operator onto the recycled space
+
+    PetscErrorCode harvest(KSP ksp, Vec b, Vec x);                   // harvest the recycled space from the latest solve
+
+    PetscErrorCode setup_pc(PC pc);                                  // set up the wrapped pc
+
+    PetscErrorCode apply_pc(PC pc, Vec r, Vec z);                    // apply the deflated pc
+
+    PetscErrorCode view_pc(PC pc, PetscViewer viewer);               // view the deflated and wrapped pc
+
+    //***************************************************************|***********************************************************//
+    // Base data access
+    //***************************************************************|***********************************************************//
+
+    const int size() const                                           // return the maximum size of the recycled space
+    { return size_; }
+
+    const int space_size() const                                     // return the current size of the recycled space
+    { return nstored_; }
+
+    const PC pc() const                                              // return the wrapped pc
+    { return pc_; }
+
+  //*****************************************************************|***********************************************************//
+  // Private functions
+  //*****************************************************************|***********************************************************//
+
+  private:                                                           // only available to this class
+
+    //***************************************************************|***********************************************************//
+    // Base data
+    //***************************************************************|***********************************************************//
+
+    int size_;                                                       // maximum number of recycled vectors
+
+    Vec *w_, *s_, *aw_;                                              // recycled space, harvested ritz vectors and the operator
+                                                                     // applied to the recycled space
+
+    Vec r_, t_;                                                      // work vectors
+
+    std::vector<PetscReal> tetar_, tetai_;                           // harvested harmonic ritz values
+
+    std::vector<PetscScalar> e_;                                     // projected operator W^T A W (row major)
+
+    std::vector<PetscScalar> g_, ework_;                             // work space for the projected solves
+
+    int nstored_;                                                    // number of recycled vectors
+
+    bool active_;                                                    // is the recycled space being used to deflate the pc
+
+    PC pc_;                                                          // the wrapped pc (as set up by the options)
+
+    PetscInt firstits_;                                              // iterations taken by the first solve (without recycling)
+
+    std::string name_;                                               // name of the ksp (for logging)
+
+    //***************************************************************|***********************************************************//
+    // Filling data
+    //***************************************************************|***********************************************************//
+
+    bool solve_projected_(std::vector<PetscScalar> &G,               // solve the projected (small, dense) system
+                          std::vector<PetscScalar> &g);
+
+  };
+
+  typedef std::shared_ptr< KrylovRecycler > KrylovRecycler_ptr;      // define a (boost shared) pointer to this class type
+
+  PetscErrorCode KrylovRecyclerPreSolve(KSP ksp, Vec b, Vec x,       // ksp pre solve callback (ctx is the recycler)
+                                        void* ctx);
+
+  PetscErrorCode KrylovRecyclerPostSolve(KSP ksp, Vec b, Vec x,      // ksp post solve callback (ctx is the recycler)
+                                         void* ctx);
+
+  PetscErrorCode KrylovRecyclerPCSetUp(PC pc);                       // shell pc set up callback (context is the recycler)
+
+  PetscErrorCode KrylovRecyclerPCApply(PC pc, Vec r, Vec z);         // shell pc apply callback (context is the recycler)
+
+  PetscErrorCode KrylovRecyclerPCView(PC pc, PetscViewer viewer);    // shell pc view callback (context is the recycler)
+
+}
+#endif
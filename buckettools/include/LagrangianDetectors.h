@@ -0,0 +1,130 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __LAGRANGIAN_DETECTORS_H
+#define __LAGRANGIAN_DETECTORS_H
+
+#include "PythonDetectors.h"
+#include "PointLocator.h"
+#include "BoostTypes.h"
+#include <dolfin.h>
+
+namespace buckettools
+{
+  
+  class Bucket;                                                      // predeclare the bucket
+
+  //*****************************************************************|************************************************************//
+  // LagrangianDetectors class:
+  //
+  // LagrangianDetectors is a derived class of PythonDetectors whose detectors (initially positioned by a python function) are
+  // advected with a velocity field at the end of every timestep using an explicit Runge-Kutta scheme.  In parallel each process
+  // advects the detectors it owns and detectors that cross into another partition are migrated to the process that owns them.
+  //*****************************************************************|************************************************************//
+  class LagrangianDetectors : public PythonDetectors
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:
+
+    //***************************************************************|***********************************************************//
+    // Constructors and destructors
+    //***************************************************************|***********************************************************//
+
+    LagrangianDetectors(const uint &meshdim, 
+                        const std::string &function, 
+                        const std::string &name,
+                        const Bucket *bucket,
+                        const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
+                        const std::string &scheme="RK4", const int &nsubsteps=1);
+    
+    ~LagrangianDetectors();
+    
+    //***************************************************************|***********************************************************//
+    // Detector evaluation
+    //***************************************************************|***********************************************************//
+
+    void advect();                                                   // advect the detectors through the last timestep (collective)
+
+    //***************************************************************|***********************************************************//
+    // Checkpointing
+    //***************************************************************|***********************************************************//
+
+    const std::string checkpoint_function(                           // return a python function that gives the current (or old)
+                                  const bool &old=false) const;      // positions of the detectors
+
+  //*****************************************************************|***********************************************************//
+  // Private functions
+  //*****************************************************************|***********************************************************//
+
+  private:
+    
+    //***************************************************************|***********************************************************//
+    // Base data
+    //***************************************************************|***********************************************************//
+
+    const Bucket *bucket_;                                           // the bucket containing the velocity
+
+    std::pair< std::string, std::pair< std::string, std::string > > 
+                                        velname_;                    // the system, type and name of the velocity
+
+    std::string scheme_;                                             // the runge-kutta scheme
+
+    int nsubsteps_;                                                  // the number of substeps the timestep is split into
+
+    std::vector<double> rka_, rkb_, rkc_;                            // the runge-kutta tableau
+
+    bool initialized_;                                               // has the velocity been found yet
+
+    GenericFunction_ptr vel_, oldvel_;                               // the velocity at the current and old times
+
+    std::vector<double> oldpositions_;                               // the positions of all the detectors (point major) before
+                                                                     // the last advection
+
+    Mesh_ptr mesh_;                                                  // the mesh of the velocity system
+
+    PointLocator_ptr locator_;                                       // finds (and evaluates the velocity at) the stage positions
+
+    std::vector< std::vector<int> > ownerranks_, ownercells_;        // the process and cell owning each stage position of the
+                                                                     // owned detectors
+    
+    //***************************************************************|***********************************************************//
+    // Initialization
+    //***************************************************************|***********************************************************//
+
+    void init_velocity_();                                           // find the velocity (once the functions are allocated)
+
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    void migrate_(std::vector<double> &x,                            // hand the detectors that have left this partition to their
+                  const std::vector<double> &x0);                    // new owners and share the new positions (collective)
+    
+  };
+  
+  typedef std::shared_ptr< LagrangianDetectors > LagrangianDetectors_ptr;// define a (boost shared) pointer for this class type
+  
+}
+
+#endif
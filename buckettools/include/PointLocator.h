@@ -0,0 +1,119 @@
+// Copyright (C) 2013 Columbia University in the City of New York and others.
+//
+// Please see the AUTHORS file in the main source directory for a full list
+// of contributors.
+//
+// This file is part of TerraFERMA.
+//
+// TerraFERMA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TerraFERMA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __POINT_LOCATOR_H
+#define __POINT_LOCATOR_H
+
+#include "BoostTypes.h"
+#include <dolfin.h>
+
+namespace buckettools
+{
+
+  //*****************************************************************|************************************************************//
+  // PointLocator class:
+  //
+  // The PointLocator class finds the cells containing points on a (possibly distributed) mesh, walking through the cell neighbours
+  // from a nearby cell where possible, and evaluates functions at points that may lie on other processes.
+  //*****************************************************************|************************************************************//
+  class PointLocator
+  {
+
+  //*****************************************************************|***********************************************************//
+  // Publicly available functions
+  //*****************************************************************|***********************************************************//
+
+  public:                                                            // available to everyone
+
+    //***************************************************************|***********************************************************//
+    // Constructors and destructors
+    //***************************************************************|***********************************************************//
+
+    PointLocator(Mesh_ptr mesh);                                     // specific constructor
+
+    ~PointLocator();                                                 // default destructor
+
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    const int findcell(const dolfin::Point &p,                       // find the local cell containing p (walking from hint first),
+                       const int &hint) const;                       // -1 if it isn't on this process
+
+    const int walk(const dolfin::Point &p,                           // walk through the cell neighbours from start towards p
+                   const int &start) const;
+
+    void locate(const std::vector<double> &points,                   // find the local cells containing a batch of points (point
+                std::vector<int> &cells) const;                      // major, -1 if they aren't on this process) - collective
+
+    void eval_local(const std::vector< GenericFunction_ptr > &functions,
+                    const double *x, const int &cellindex,           // evaluate the functions at x in a local cell
+                    double *values) const;
+
+    void eval_distributed(                                           // evaluate the functions at the active points, sending
+                  const std::vector< GenericFunction_ptr > &functions,// points outside this partition to their owning process
+                  const std::vector<double> &points,                 // (collective)
+                  const std::vector<bool> &active,
+                  std::vector<int> &owners,
+                  std::vector<int> &cells,
+                  std::vector<double> &values,
+                  std::vector<bool> &found) const;
+
+    //***************************************************************|***********************************************************//
+    // Base data access
+    //***************************************************************|***********************************************************//
+
+    const Mesh_ptr mesh() const                                      // return the mesh
+    { return mesh_; }
+
+    const bool walkable() const                                      // return true if points can be found by walking
+    { return walkable_; }
+
+  //*****************************************************************|***********************************************************//
+  // Private functions
+  //*****************************************************************|***********************************************************//
+
+  private:                                                           // only available to this class
+
+    //***************************************************************|***********************************************************//
+    // Base data
+    //***************************************************************|***********************************************************//
+
+    Mesh_ptr mesh_;                                                  // the mesh
+
+    uint dim_;                                                       // the geometric dimension of the mesh
+
+    bool walkable_;                                                  // can we walk through the cell neighbours to find points
+
+    std::vector<double> bboxmin_, bboxmax_;                          // bounding box of the local partition (including ghosts)
+
+    //***************************************************************|***********************************************************//
+    // Filling data
+    //***************************************************************|***********************************************************//
+
+    const bool inbbox_(const double *x) const;                       // is x in the bounding box of the local partition
+
+  };
+
+  typedef std::shared_ptr< PointLocator > PointLocator_ptr;          // define a (boost shared) pointer to this class type
+
+}
+
+#endif
@@ -25,6 +25,8 @@
 #include "Python.h"
 #include <dolfin.h>
 #include "PythonInstance.h"
+#include "BatchRecorder.h"
+#include "ExpressionDependence.h"
 #include "BoostTypes.h"
 
 namespace buckettools
@@ -35,8 +37,10 @@ namespace buckettools
   //
   // The PythonExpression class describes a derived dolfin Expression class that overloads
   // the eval function using python
+  // If the python function is vectorized (val.vectorized = True) it is called once per cell (or batch of cells when
+  // interpolating) with an array of points rather than once per point.
   //*****************************************************************|************************************************************//
-  class PythonExpression : public dolfin::Expression
+  class PythonExpression : public dolfin::Expression, public ExpressionDependence
   {
 
   //*****************************************************************|***********************************************************//
@@ -73,7 +77,23 @@ namespace buckettools
     
     void eval(dolfin::Array<double>& values,                         // evaluate the expression at a given point
               const dolfin::Array<double>& x) const;                 // (but no cell information?)
+
+    void restrict(double* w, const dolfin::FiniteElement& element,   // restrict the expression to a cell (evaluating all the
+                  const dolfin::Cell& dolfin_cell,                   // points in the cell in one call if vectorized)
+                  const double* coordinate_dofs, 
+                  const ufc::cell& ufc_cell) const;
     
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    void eval_batch(std::vector<double> &values,                     // evaluate the expression at a batch of points (values are
+                    const std::vector<double> &x,                    // returned point major)
+                    const std::size_t &npoints) const;
+
+    void interpolate(dolfin::Function &function) const;              // interpolate the expression into a function (in batches of
+                                                                     // cells if vectorized)
+
 
     //***************************************************************|***********************************************************//
     // Base data access
@@ -81,6 +101,12 @@ namespace buckettools
     
     const bool time_dependent() const;                               // return if this expression is time dependent or not
 
+    const bool time_only() const                                     // python expressions only depend on position and time
+    { return true; }
+
+    const bool vectorized() const                                    // return if this expression is evaluated in batches of points
+    { return pyinst_.vectorized(); }
+
   //*****************************************************************|***********************************************************//
   // Private functions
   //*****************************************************************|***********************************************************//
@@ -95,6 +121,11 @@ namespace buckettools
 
     double_ptr time_;                                                // the time this function is to be evaluated at
 
+    mutable BatchRecorder recorder_;                                 // records the dof points of a cell when restricting (kept
+                                                                     // between cells to reuse its storage)
+
+    mutable std::vector<double> cellvalues_;                         // the values at the recorded points of a cell
+
   };
 
 }
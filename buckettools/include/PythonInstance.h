@@ -63,9 +63,15 @@ namespace buckettools
 
     PyObject* call(PyObject *pArgs) const;                           // run the function contained in this python instance
 
+    PyObject* call_batch(PyObject *pArgs) const;                     // run the (vectorized) function contained in this python
+                                                                     // instance on a batch of points
+
     const int number_arguments() const                               // return the number of arguments expected by this pythoninstance
     { return nargs_; }
 
+    const bool vectorized() const                                    // return true if the function accepts arrays of points
+    { return vectorized_; }
+
     void print_error() const;                                        // prints an error to the error stream
 
   //*****************************************************************|***********************************************************//
@@ -82,7 +88,11 @@ namespace buckettools
 
     PyObject *pLocals_, *pCode_, *pFunc_;                            // python objects used to run the function (and cacheable between calls)
 
+    PyObject *pBatchFunc_;                                           // python wrapper used to run the function on a batch of points
+
     int nargs_;                                                      // the number of arguments this python function takes
+
+    bool vectorized_;                                                // the function accepts (and returns) arrays of points
     
     //***************************************************************|***********************************************************//
     // Initialization
@@ -25,6 +25,7 @@
 #include <dolfin.h>
 #include "BoostTypes.h"
 #include "Bucket.h"
+#include "ExpressionDependence.h"
 
 namespace buckettools
 {
@@ -35,7 +36,7 @@ namespace buckettools
   // This class provides a method of overloading a dolfin Expression eval function by looping over cell ids and returning the results
   // of individual expressions in each of those regions.
   //*****************************************************************|************************************************************//
-  class RegionsExpression : public dolfin::Expression
+  class RegionsExpression : public dolfin::Expression, public ExpressionDependence
   {
 
   //*****************************************************************|***********************************************************//
@@ -74,6 +75,13 @@ namespace buckettools
               const dolfin::Array<double>& x, 
               const ufc::cell &cell) const;
     
+    //***************************************************************|***********************************************************//
+    // Functions used to run the model
+    //***************************************************************|***********************************************************//
+
+    void interpolate(dolfin::Function &function) const;              // interpolate the expression into a function (one region at
+                                                                     // a time)
+    
     //***************************************************************|***********************************************************//
     // Base data access
     //***************************************************************|***********************************************************//
@@ -83,6 +91,11 @@ namespace buckettools
     
     std::map< std::size_t, Expression_ptr> expressions()                    // return the map of expressions (non-const version)
     { return expressions_; }
+
+    const bool time_dependent() const;                               // return if any of the region expressions depend on time
+
+    const bool time_only() const;                                    // return if all of the region expressions only depend on
+                                                                     // position and time
     
   //*****************************************************************|***********************************************************//
   // Private functions
@@ -98,6 +111,33 @@ namespace buckettools
   
     MeshFunction_size_t_ptr cell_ids_;                                 // a (boost shared) pointer to a (uint) mesh function holding the cell ids
 
+    //***************************************************************|***********************************************************//
+    // Base data
+    //***************************************************************|***********************************************************//
+
+    std::vector< Expression_ptr > table_;                            // dense table from region id to expression (null if no
+                                                                     // expression is defined for that id), sized to the largest
+                                                                     // region id + 1 so left empty (and the map used instead) if
+                                                                     // the ids are too sparse
+
+    mutable std::map< std::size_t, std::vector<std::size_t> > regioncells_;// the cells in each region (filled on the first
+                                                                     // interpolation)
+
+    //***************************************************************|***********************************************************//
+    // Filling data
+    //***************************************************************|***********************************************************//
+
+    void fill_table_();                                              // fill the dense table of expressions
+
+    void fill_regioncells_() const;                                  // fill the lists of cells in each region
+
+    //***************************************************************|***********************************************************//
+    // Base data access (continued)
+    //***************************************************************|***********************************************************//
+
+    const dolfin::Expression* expression_(const std::size_t &id) const;// return the expression for a region id (null if there
+                                                                     // isn't one)
+
   };
 
 }
@@ -25,35 +25,19 @@
 #include "BoostTypes.h"
 #include "Bucket.h"
 #include "SystemBucket.h"
+#include "PointLocator.h"
 #include <dolfin.h>
 
 namespace buckettools
 {
-  struct lt_point
-  {
-    bool operator() (const dolfin::Point& p1, const dolfin::Point& p2) const
-    {
-      for (unsigned int i = 0; i < 3; ++i)
-      {
-        if (p1[i] < (p2[i] - DOLFIN_EPS))
-          return true;
-        else if (p1[i] > (p2[i] + DOLFIN_EPS))
-          return false;
-      }
-
-      return false;
-    }
-  };
-  
-  typedef std::map<dolfin::Point, std::vector<int>, lt_point> point_map;
-  typedef point_map::iterator point_iterator;
-
 
   //*****************************************************************|************************************************************//
   // SemiLagrangianExpression class:
   //
   // The SemiLagrangianExpression class describes a derived dolfin Expression class that overloads
-  // the eval function using a user defined data.
+  // the eval function using a user defined data.  In parallel it can only be interpolated using interpolate, which sends departure
+  // points that leave the local partition to the process that owns them (eval and restrict only search the local partition so
+  // refuse to run in parallel).
   //*****************************************************************|************************************************************//
   class SemiLagrangianExpression : public dolfin::Expression
   {
@@ -67,19 +51,22 @@ namespace buckettools
     SemiLagrangianExpression(const Bucket *bucket, const double_ptr time, 
                              const std::pair< std::string, std::pair< std::string, std::string > > &function,
                              const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                             const std::pair< std::string, std::pair< std::string, std::string > > &outside);
+                             const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                             const std::string &scheme="Midpoint", const int &nsubsteps=1);
 
     SemiLagrangianExpression(const std::size_t &dim,
                              const Bucket *bucket, const double_ptr time, 
                              const std::pair< std::string, std::pair< std::string, std::string > > &function,
                              const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                             const std::pair< std::string, std::pair< std::string, std::string > > &outside);
+                             const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                             const std::string &scheme="Midpoint", const int &nsubsteps=1);
 
     SemiLagrangianExpression(const std::vector<std::size_t> &value_shape,
                              const Bucket *bucket, const double_ptr time, 
                              const std::pair< std::string, std::pair< std::string, std::string > > &function,
                              const std::pair< std::string, std::pair< std::string, std::string > > &velocity,
-                             const std::pair< std::string, std::pair< std::string, std::string > > &outside);
+                             const std::pair< std::string, std::pair< std::string, std::string > > &outside,
+                             const std::string &scheme="Midpoint", const int &nsubsteps=1);
 
     ~SemiLagrangianExpression();
     
@@ -87,7 +74,15 @@ namespace buckettools
               const dolfin::Array<double>& x, 
               const ufc::cell &cell) const;
     
+    void restrict(double* w, const dolfin::FiniteElement& element,  // restrict to a cell (keeping track of which cell and
+                  const dolfin::Cell& dolfin_cell,                   // evaluation point eval is being called for)
+                  const double* coordinate_dofs,
+                  const ufc::cell& ufc_cell) const;
+    
     void init();
+
+    void interpolate(dolfin::Function &function) const;              // interpolate the expression into a function (tracing the
+                                                                     // departure points of all its dofs together, in parallel)
   
   //*****************************************************************|***********************************************************//
   // Private functions
@@ -111,6 +106,14 @@ namespace buckettools
 
     std::pair< std::string, std::pair< std::string, std::string > > 
                                         funcname_, velname_, outname_;
+
+    std::string scheme_;                                             // the departure point integration scheme
+
+    int nsubsteps_;                                                  // the number of substeps used by the runge-kutta schemes
+
+    std::vector<double> rka_, rkb_, rkc_;                            // the runge-kutta tableau (empty for the midpoint scheme)
+
+    mutable std::vector<double> rky_, rkk_;                          // work space for the runge-kutta schemes
     
     GenericFunction_ptr vel_, oldvel_;
     GenericFunction_ptr func_, out_;
@@ -124,18 +127,43 @@ namespace buckettools
 
     dolfin::Array<double> *v_, *oldv_, *vstar_;
 
-    dolfin::MeshFunction< point_map > *cellcache_;
+    mutable std::size_t npercell_;                                   // number of evaluation points per cell (0 if not yet known)
+
+    mutable std::vector<int> midcells_, endcells_;                   // cells containing the midpoint and departure point of each
+                                                                     // (cell, evaluation point) in the last eval (-1 if unknown)
+
+    mutable int currentcell_;                                        // the cell and evaluation point being restricted to
+    mutable std::size_t currentpoint_;
+
+    PointLocator_ptr locator_;                                       // finds (and evaluates functions at) the departure points
+
+    mutable std::vector< std::vector<int> > ownerranks_, ownercells_;// the process and cell owning each departure point in the
+                                                                     // last interpolation (at the midpoint and the end)
     
     const bool findpoint_(const dolfin::Array<double>& x, 
                           const ufc::cell &cell) const;
 
-    void findvstar_(const dolfin::Array<double>& x, 
-                    const ufc::cell &cell) const;
+    const bool findpoint_rungekutta_(const dolfin::Array<double>& x, // find the launch point using the runge-kutta schemes
+                                     const ufc::cell &cell) const;
 
-    const bool checkpoint_(const int &index, 
-                           point_iterator &p_it, 
-                           point_map &points, 
-                           const dolfin::Point &lp) const;
+    void findvstar_(const dolfin::Array<double>& x, 
+                    const ufc::cell &cell,
+                    const double &theta) const;
+
+    void trace_midpoint_(const std::vector<double> &x,               // trace a batch of departure points using the midpoint
+                         const std::vector<int> &pointcells,         // scheme
+                         std::vector<double> &xstar,
+                         std::vector<bool> &active,
+                         std::vector<bool> &outside) const;
+
+    void trace_rungekutta_(const std::vector<double> &x,             // trace a batch of departure points using the runge-kutta
+                           const std::vector<int> &pointcells,       // schemes
+                           std::vector<double> &xstar,
+                           std::vector<bool> &active,
+                           std::vector<bool> &outside) const;
+
+    const bool locatepoint_(int &cached,                             // locate xstar_ starting from the cached cell (or start)
+                            const int &start) const;
 
   };
 
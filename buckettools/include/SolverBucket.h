@@ -26,7 +26,10 @@
 #include "BucketPETScBase.h"
 #include "ConvergenceFile.h"
 #include "KSPConvergenceFile.h"
+#include "AndersonAccelerator.h"
+#include "KrylovRecycler.h"
 #include <dolfin.h>
+#include <set>
 #include "petscsnes.h"
 
 namespace buckettools
@@ -74,6 +77,13 @@ namespace buckettools
 
     void resetcalculated();                                          // update this solver at the end of a timestep
 
+    void update_nonlinear();                                         // update the nonlinear coefficients the forms of this solver
+                                                                     // depend on
+
+    const std::set< const dolfin::GenericFunction* >& dependencies();// return the coefficients the forms of this solver depend on
+
+    const bool unknown_dependencies();                               // return true if the dependencies are not fully known
+
     //***************************************************************|***********************************************************//
     // Filling data
     //***************************************************************|***********************************************************//
@@ -110,6 +120,12 @@ namespace buckettools
     const bool ident_zeros_pc() const                                // return true if the bilinear pc form needs to be idented
     { return ident_zeros_pc_; }
 
+    const bool matrix_free() const                                   // return true if the jacobian action is matrix-free
+    { return matrixfree_; }
+
+    const double matrix_free_memory_saved() const                    // return an estimate of the memory (in bytes) of the
+    { return mfmemorysaved_; }                                       // jacobian that the matrix-free action avoids assembling
+
     const Form_ptr linear_form() const                               // return a (boost shared) pointer to the linear form
     { return linear_; }
 
@@ -146,6 +162,15 @@ namespace buckettools
     const bool solved() const                                        // return a boolean indicating if this system has been solved
     { return *solved_; }                                             // for or not
 
+    void recoverable_failures(const bool &recoverable)               // set whether failures should be recorded (so the caller can
+    { recoverable_ = recoverable; }                                  // recover from them) rather than terminating the simulation
+
+    const bool failed() const                                        // return true if a recoverable failure has been recorded
+    { return failed_; }
+
+    void reset_failed()                                              // forget any recorded failure
+    { failed_ = false; }
+
     //***************************************************************|***********************************************************//
     // Form data access
     //***************************************************************|***********************************************************//
@@ -187,6 +212,52 @@ namespace buckettools
 
     Mat fetch_solversubmatrix(const std::string &name);              // fetch the named solver submatrix
 
+    //***************************************************************|***********************************************************//
+    // Assembly data access
+    //***************************************************************|***********************************************************//
+
+    SystemAssembler_ptr system_assembler()                           // return the persistent system assembler for the bilinear
+    { return systemassembler_; }                                     // form
+
+    SystemAssembler_ptr system_assembler_pc()                        // return the persistent system assembler for the bilinear
+    { return systemassemblerpc_; }                                   // pc form
+
+    SystemAssembler_ptr fetch_solversystemassembler(const std::string &name);// fetch the named solver form system assembler
+
+    Assembler_ptr assembler()                                        // return the persistent assembler for linear and residual
+    { return assembler_; }                                           // forms
+
+    const double assembly_time() const                               // return the wall time spent assembling during this solve
+    { return assemblytime_; }
+
+    void add_assembly_time(const double &time)                       // add to the wall time spent assembling during this solve
+    { assemblytime_ += time; }
+
+    const double assembly_setup_saved() const                        // return the wall time saved during this solve by reusing
+    { return assemblysetupsaved_; }                                  // the persistent assemblers (estimated from their setup times)
+
+    void reused_system_assemblers()                                  // record that the system assemblers were reused rather than
+    { assemblysetupsaved_ += systemassemblersetup_; }                // rebuilt
+
+    void reused_assembler()                                          // record that the assembler was reused rather than rebuilt
+    { assemblysetupsaved_ += assemblersetup_; }
+
+    bool form_changed(const Form_ptr form);                          // return true if the coefficients of the form have changed
+                                                                     // since it was last checked (and record their new state)
+
+    const int matrix_assemblies() const                              // return the number of matrices reassembled during this solve
+    { return matrixassemblies_; }
+
+    //***************************************************************|***********************************************************//
+    // Preconditioner data access
+    //***************************************************************|***********************************************************//
+
+    const bool pc_reused() const                                     // return true if the preconditioner was reused in the
+    { return pcreused_; }                                            // latest linear solve
+
+    const double pc_setup_time() const                               // return the wall time spent setting up the latest linear
+    { return pcsetuptime_; }                                         // solve
+
     //***************************************************************|***********************************************************//
     // Output functions
     //***************************************************************|***********************************************************//
@@ -221,6 +292,15 @@ namespace buckettools
 
     PETScMatrix_ptr matrix_, matrixpc_;                              // dolfin petsc matrix types
 
+    bool matrixfree_;                                                // use a matrix-free jacobian action (snes only, matrix_ is
+                                                                     // not allocated)
+
+    double mffunctionerror_;                                         // relative error in the residual for the finite differences
+                                                                     // (negative for the petsc default)
+
+    double mfmemorysaved_;                                           // estimated memory of the jacobian not assembled when
+                                                                     // matrix-free
+
     std::map< std::string, PETScMatrix_ptr > solvermatrices_;        // dolfin petsc matrices for solver matrices
 
     std::map< std::string, IS > solverindexsets_;                    // (boost shared) pointers to the indexsets defining the solver submatrices
@@ -229,12 +309,67 @@ namespace buckettools
 
     PETScVector_ptr rhs_, res_, work_;                               // dolfin petsc vector types
 
+    SystemAssembler_ptr systemassembler_, systemassemblerpc_;        // persistent system assemblers (matrix and pc)
+
+    std::map< std::string, SystemAssembler_ptr > solversystemassemblers_;// persistent system assemblers for the solver forms
+
+    Assembler_ptr assembler_;                                        // persistent assembler for the linear and residual forms
+
+    double assemblytime_;                                            // wall time spent assembling during the current solve
+
+    double systemassemblersetup_, assemblersetup_;                   // wall time taken to build the persistent system assemblers
+                                                                     // and assembler
+
+    double assemblysetupsaved_;                                      // wall time saved by reusing the assemblers during the current
+                                                                     // solve
+
+    std::map< const dolfin::Form*, std::vector<double> > formsignatures_;// coefficient states of the forms when last assembled
+
+    int matrixassemblies_;                                           // number of matrices reassembled during the current solve
+
+    std::vector< FunctionBucket_ptr > nonlinearcoeffs_;              // the (ordered) coefficients that update_nonlinear needs to
+                                                                     // update for the forms in this solver
+
+    bool nonlinearcoeffs_filled_, nonlinearcoeffs_all_;              // have the nonlinear coefficients been found and do we need
+                                                                     // to update all the nonlinear coefficients in the bucket
+
+    std::set< const dolfin::GenericFunction* > dependencies_;        // all the coefficients the forms in this solver depend on
+
+    bool reusepc_;                                                   // reuse the preconditioner between linear solves (if possible)
+
+    int pcmaxsteps_;                                                 // maximum number of solves before the pc is rebuilt (0 no limit)
+
+    double pcgrowthfactor_;                                          // ksp iteration growth that triggers a pc rebuild
+
+    int pcsteps_, pcbaseits_, pclastits_;                            // solves since the last pc rebuild, ksp iterations taken
+                                                                     // directly after the rebuild and in the latest solve
+
+    bool pcreused_;                                                  // was the pc reused in the latest solve
+
+    double pcsetuptime_;                                             // wall time spent in the latest ksp setup
+
+    bool ew_;                                                        // adapt the ksp relative tolerance (eisenstat-walker)
+
+    double ewrtol0_, ewrtolmax_, ewrtolmin_;                         // initial, maximum and minimum adaptive ksp tolerances
+
+    double ewgamma_, ewalpha_;                                       // eisenstat-walker forcing term parameters
+
+    double ewrtol_;                                                  // the latest adaptive ksp relative tolerance
+
+    int recyclesize_;                                                // maximum size of the recycled krylov space (0 if none)
+
+    KrylovRecycler_ptr recycler_;                                    // recycles a deflation space between linear solves
+
     double rtol_, atol_, stol_;                                      // nonlinear solver tolerances
 
     int minits_, maxits_, maxfes_;                                   // nonlinear solver iteration counts
 
     double relax_;                                                   // relaxation parameter
 
+    int andersondepth_;                                              // anderson acceleration history depth (0 if not accelerated)
+
+    AndersonAccelerator_ptr anderson_;                               // anderson acceleration of the picard iterations
+
     int_ptr iteration_count_;                                        // nonlinear iterations taken (may not be accurate!)
 
     bool ident_zeros_, ident_zeros_pc_;                              // replace zero rows with the identity (matrix and pc)
@@ -243,6 +378,9 @@ namespace buckettools
 
     bool ignore_failures_;                                           // ignore solver failures
 
+    bool recoverable_, failed_;                                      // record failures rather than terminating (and whether one
+                                                                     // has been recorded)
+
     std::string name_;                                               // solver name
 
     std::string type_;                                               // solver type (string)
@@ -304,6 +442,30 @@ namespace buckettools
     void ksp_check_convergence_(KSP &ksp)                            // check ksp convergence (no indent)
     { ksp_check_convergence_(ksp, 0); }
 
+    //***************************************************************|***********************************************************//
+    // Nonlinear coefficient dependencies
+    //***************************************************************|***********************************************************//
+
+    void fill_nonlinear_coeffs_();                                   // find the nonlinear coefficients the forms depend on
+
+    bool add_form_dependencies_(const Form_ptr form,                 // add the coefficients of a form to a set of dependencies
+                       std::set< const dolfin::GenericFunction* > &dependencies);
+
+    //***************************************************************|***********************************************************//
+    // Preconditioner reuse
+    //***************************************************************|***********************************************************//
+
+    bool reuse_pc_();                                                // decide whether to reuse the pc in the next linear solve
+
+    void record_pc_reuse_();                                         // record the outcome of a linear solve for the reuse policy
+
+    //***************************************************************|***********************************************************//
+    // Adaptive linear solver tolerances
+    //***************************************************************|***********************************************************//
+
+    void update_ksp_rtol_(const double &aerror,                      // set the eisenstat-walker ksp relative tolerance for the
+                          const double &aerrorold);                  // next linear solve
+
   };
 
   typedef std::shared_ptr< SolverBucket > SolverBucket_ptr;        // define a (boost shared) pointer to the solver class type
@@ -112,6 +112,8 @@ namespace buckettools
 
     void fill_solvers_();                                            // fill in the solver bucket information
 
+    void fill_subcycling_();                                         // fill in the subcycling constraint (if any)
+
     void fill_functionals_();                                        // fill in the functional bucket information
 
   };
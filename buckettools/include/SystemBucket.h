@@ -96,6 +96,74 @@ namespace buckettools
 
     const std::vector<int> solve_locations() const;                  // return a std::vector indicating the solve locations of the solvers
 
+    const bool owns_function(const dolfin::GenericFunction* function)// return true if the function is the (iterated) function of
+                                                           const;    // this system or one of its fields
+
+    const bool depends_on(const SystemBucket &system);               // return true if the solvers of this system depend on the
+                                                                     // (iterated) solution of the given system
+
+    void start_iterating();                                          // reset the per timestep solve tracking at the start of the
+                                                                     // nonlinear systems iterations
+
+    const double iterated_change() const;                            // return the relative change in the iterated function over
+                                                                     // the latest iteration
+
+    void add_input_change(const double &change)                      // accumulate the change in the systems this system depends on
+    { inputchange_ += change; }
+
+    void reset_input_change()                                        // reset the accumulated input change (after a solve)
+    { inputchange_ = 0.0; }
+
+    const double input_change() const                                // return the accumulated input change since the last solve
+    { return inputchange_; }
+
+    void set_skipped(const bool &skipped)                            // record if the latest lazy solve of this system was skipped
+    { skipped_ = skipped; }
+
+    const bool skipped() const                                       // return true if the latest lazy solve of this system was
+    { return skipped_; }                                             // skipped
+
+    const double last_residual_norm() const                          // return the latest residual norm calculated
+    { return residualnorm_; }
+
+    const double initial_residual_norm() const                       // return the residual norm at the start of the nonlinear
+    { return residualnorm0_; }                                       // systems iterations
+
+    const int solve_count() const                                    // return the number of solves since start_iterating
+    { return solvecount_; }
+
+    void store_state();                                              // store the function values at the start of a timestep
+
+    void restore_state();                                            // restore the function values stored at the start of the
+                                                                     // timestep (rolling back a rejected timestep)
+
+    const double error_norm(const double &ratio, const double &rtol, // return a weighted norm of the estimated time discretization
+                            const double &atol);                     // error in the latest timestep (negative if not available)
+
+    void recoverable_failures(const bool &recoverable);              // set whether solver failures are recoverable
+
+    const bool failed() const;                                       // return true if any solver has recorded a failure
+
+    void reset_failed();                                             // forget any recorded solver failures
+
+    void update_substeps();                                          // update the number of substeps for the next timestep
+
+    const int substeps() const                                       // return the number of substeps in the current timestep
+    { return substeps_; }
+
+    void begin_interpolation();                                      // store the (iterated and old) functions before interpolating
+                                                                     // them in time for a subcycled system
+
+    void interpolate(const double &oldfraction,                      // interpolate the old and iterated functions linearly in time
+                     const double &fraction);                        // between the stored old and iterated values
+
+    void end_interpolation();                                        // restore the functions stored by begin_interpolation
+
+    void advance_substep();                                          // make the latest substep solution the old function
+
+    void end_substeps();                                             // restore the old function of a subcycled system (stored by
+                                                                     // begin_interpolation)
+
     const bool solved(const int &location) const;                    // return a boolean indicating if this system has been solved
 
     const bool solved(const std::vector<int> &locations=
@@ -315,6 +383,8 @@ namespace buckettools
 
     void apply_bcs_();                                               // apply the Dirichlet bcs to the system function
 
+    void extrapolate_();                                             // extrapolate the initial guess for the next timestep
+
     //***************************************************************|***********************************************************//
     // Base data
     //***************************************************************|***********************************************************//
@@ -343,6 +413,42 @@ namespace buckettools
 
     Function_ptr snesupdatefunction_;                                // (boost shared) pointer to the snes update of the system
 
+    double residualnorm_, residualnorm0_;                            // latest residual norm and that at the start of the
+                                                                     // nonlinear systems iterations
+
+    double inputchange_;                                             // change in the systems this system depends on since its
+                                                                     // last solve
+
+    bool skipped_;                                                   // was the latest lazy solve of this system skipped
+
+    int solvecount_;                                                 // number of solves since the start of the nonlinear systems
+                                                                     // iterations
+
+    int extrapolationorder_;                                         // order of the initial guess extrapolation (0 if none)
+
+    std::vector< GenericVector_ptr > extrapvecs_;                    // ring of previous time levels (most recent first, not
+                                                                     // including the oldfunction)
+
+    std::vector< double > extraptimes_;                              // times of the previous time levels
+
+    int nextrap_;                                                    // number of previous time levels stored
+
+    double oldtime_;                                                 // time of the oldfunction (-HUGE_VAL if not yet set)
+
+    std::vector< GenericVector_ptr > statevecs_;                     // function and oldfunction at the start of the timestep and
+                                                                     // the previous time level
+
+    int nstates_;                                                    // number of time levels stored in the state vectors
+
+    GenericVector_ptr errorvec_, weightvec_;                         // work vectors for the error estimate
+
+    int nsubsteps_, substeps_;                                       // minimum and current number of substeps per timestep
+
+    std::pair< FunctionBucket_ptr, double > subcycleconstraint_;     // constraint on the number of substeps < function, max value >
+
+    std::vector< GenericVector_ptr > interpvecs_;                    // the (old and iterated) functions stored while being
+                                                                     // interpolated in time
+
     //***************************************************************|***********************************************************//
     // Pointers data
     //***************************************************************|***********************************************************//
@@ -38,10 +38,17 @@ class CppExpressionBucket:
     self.basetype = None
     self.nametype = None
     self.include  = None
+    self.timedependent = True
+    self.timeonly      = False
   
   def namespace(self):
     return self.function.system.name+self.function.name+self.name+self.nametype+"Expression"
 
+  def dependence_cpp(self):
+    """Return the cpp constructor arguments describing whether the cpp expression depends on time and whether it only depends
+       on position and time."""
+    return str(self.timedependent).lower()+", "+str(self.timeonly).lower()
+
   def cpp(self):
     """Write the cpp expression to an array of cpp header strings."""
     cpp = []
@@ -53,6 +60,7 @@ class CppExpressionBucket:
     cpp.append("#include \"SystemBucket.h\""+os.linesep)
     cpp.append("#include \"BoostTypes.h\""+os.linesep)
     cpp.append("#include \"Logger.h\""+os.linesep)
+    cpp.append("#include \"ExpressionDependence.h\""+os.linesep)
     cpp.append("#include <dolfin.h>"+os.linesep)
     if self.include:
       for line in self.include.split(os.linesep):
@@ -65,9 +73,10 @@ class CppExpressionBucket:
     cpp.append("  // "+self.namespace()+" class:"+os.linesep)
     cpp.append("  //"+os.linesep)
     cpp.append("  // The "+self.namespace()+" class describes a derived dolfin Expression class that overloads"+os.linesep)
-    cpp.append("  // the eval function using a user defined data."+os.linesep)
+    cpp.append("  // the eval function using a user defined data.  What it depends on is set from the options when it is"+os.linesep)
+    cpp.append("  // constructed."+os.linesep)
     cpp.append("  //*****************************************************************|************************************************************//"+os.linesep)
-    cpp.append("  class "+self.namespace()+" : public dolfin::Expression"+os.linesep)
+    cpp.append("  class "+self.namespace()+" : public dolfin::Expression, public ExpressionDependence"+os.linesep)
     cpp.append("  {"+os.linesep)
     cpp.append("  "+os.linesep)
     cpp.append("  //*****************************************************************|***********************************************************//"+os.linesep)
@@ -77,11 +86,11 @@ class CppExpressionBucket:
     cpp.append("  public:                                                            // available to everyone"+os.linesep)
     cpp.append("  "+os.linesep)
     if self.rank == "Scalar":
-      cpp.append("    "+self.namespace()+"(const Bucket *bucket, const SystemBucket *system, const double_ptr time) : dolfin::Expression(), bucket_(bucket), system_(system), time_(time), initialized_(false)"+os.linesep)
+      cpp.append("    "+self.namespace()+"(const Bucket *bucket, const SystemBucket *system, const double_ptr time, const bool &timedependent, const bool &timeonly) : dolfin::Expression(), bucket_(bucket), system_(system), time_(time), timedependent_(timedependent), timeonly_(timeonly), initialized_(false)"+os.linesep)
     elif self.rank == "Vector":
-      cpp.append("    "+self.namespace()+"(const std::size_t &dim, const Bucket *bucket, const SystemBucket *system, const double_ptr time) : dolfin::Expression(dim), bucket_(bucket), system_(system), time_(time), initialized_(false)"+os.linesep)
+      cpp.append("    "+self.namespace()+"(const std::size_t &dim, const Bucket *bucket, const SystemBucket *system, const double_ptr time, const bool &timedependent, const bool &timeonly) : dolfin::Expression(dim), bucket_(bucket), system_(system), time_(time), timedependent_(timedependent), timeonly_(timeonly), initialized_(false)"+os.linesep)
     elif self.rank == "Tensor":
-      cpp.append("    "+self.namespace()+"(const std::vector<std::size_t> &value_shape, const Bucket *bucket, const SystemBucket *system, const double_ptr time) : dolfin::Expression(value_shape), bucket_(bucket), system_(system), time_(time), initialized_(false)"+os.linesep)
+      cpp.append("    "+self.namespace()+"(const std::vector<std::size_t> &value_shape, const Bucket *bucket, const SystemBucket *system, const double_ptr time, const bool &timedependent, const bool &timeonly) : dolfin::Expression(value_shape), bucket_(bucket), system_(system), time_(time), timedependent_(timedependent), timeonly_(timeonly), initialized_(false)"+os.linesep)
     else:
       print(self.rank)
       print("Unknown rank.")
@@ -104,6 +113,16 @@ class CppExpressionBucket:
       cpp.append("      "+line+os.linesep)
     cpp.append("    }"+os.linesep)
     cpp.append("    "+os.linesep)
+    cpp.append("    const bool time_dependent() const"+os.linesep)
+    cpp.append("    {"+os.linesep)
+    cpp.append("      return timedependent_;"+os.linesep)
+    cpp.append("    }"+os.linesep)
+    cpp.append("    "+os.linesep)
+    cpp.append("    const bool time_only() const"+os.linesep)
+    cpp.append("    {"+os.linesep)
+    cpp.append("      return timeonly_;"+os.linesep)
+    cpp.append("    }"+os.linesep)
+    cpp.append("    "+os.linesep)
     cpp.append("    void init()"+os.linesep)
     cpp.append("    {"+os.linesep)
     cpp.append("      if (!initialized_)"+os.linesep)
@@ -142,6 +161,10 @@ class CppExpressionBucket:
     cpp.append("    "+os.linesep)
     cpp.append("    const double_ptr time_;"+os.linesep)
     cpp.append("    "+os.linesep)
+    cpp.append("    const bool timedependent_;"+os.linesep)
+    cpp.append("    "+os.linesep)
+    cpp.append("    const bool timeonly_;"+os.linesep)
+    cpp.append("    "+os.linesep)
     cpp.append("    bool initialized_;"+os.linesep)
     cpp.append("    "+os.linesep)
     for line in self.members.split(os.linesep):
@@ -192,11 +215,11 @@ class CppExpressionBucket:
       cpp.append("          else if (expressionname ==  \""+self.name+"\")"+os.linesep)
     cpp.append("          {"+os.linesep)
     if self.rank == "Scalar":
-      cpp.append("            expression.reset(new "+self.namespace()+"(bucket, system, time));"+os.linesep)
+      cpp.append("            expression.reset(new "+self.namespace()+"(bucket, system, time, "+self.dependence_cpp()+"));"+os.linesep)
     elif self.rank == "Vector":
-      cpp.append("            expression.reset(new "+self.namespace()+"(size, bucket, system, time));"+os.linesep)
+      cpp.append("            expression.reset(new "+self.namespace()+"(size, bucket, system, time, "+self.dependence_cpp()+"));"+os.linesep)
     elif self.rank == "Tensor":
-      cpp.append("            expression.reset(new "+self.namespace()+"(shape, bucket, system, time));"+os.linesep)
+      cpp.append("            expression.reset(new "+self.namespace()+"(shape, bucket, system, time, "+self.dependence_cpp()+"));"+os.linesep)
     else:
       print(self.rank)
       print("Unknown rank.")
@@ -37,6 +37,10 @@ class SpudCppExpressionBucket(buckettools.cppexpressionbucket.CppExpressionBucke
     if libspud.have_option(optionpath+"/cpp/include"):
       self.include = libspud.get_option(optionpath+"/cpp/include")
 
+    # cpp expressions may depend on anything in the bucket unless the options say otherwise
+    self.timedependent = not libspud.have_option(optionpath+"/cpp/time_independent")
+    self.timeonly      = not self.timedependent or libspud.have_option(optionpath+"/cpp/depends_only_on_time")
+
     self.basetype     = libspud.get_option(optionpath+"/type")
     if self.basetype=="initial_condition":
       self.nametype = "IC"
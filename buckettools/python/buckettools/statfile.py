@@ -47,7 +47,6 @@
 # You should have received a copy of the GNU Lesser General Public License
 # along with TerraFERMA. If not, see <http://www.gnu.org/licenses/>.
 
-import array
 import os
 import re
 import numpy
@@ -210,11 +209,7 @@ for example:
           if name == "real_size":
             assert(vtype == "integer")            
             real_size = int(value)            
-            if real_size == 4:
-              realFormat = 'f'
-            elif real_size == 8:
-              realFormat = 'd'
-            else:
+            if real_size not in [4, 8]:
               raise Exception("Unexpected real size: " + str(real_size))
           elif name == "integer_size":
             assert(vtype == "integer")            
@@ -222,30 +217,16 @@ for example:
             if not integer_size == 4:
               raise Exception("Unexpected integer size: " + str(integer_size))
        
-        nOutput = int( (os.path.getsize(filename + ".dat") / (nColumns * real_size)) / subsample)
-        
-        columns = numpy.empty((nColumns, nOutput))
-        statDatFile = open(filename + ".dat", "rb")   
-        index = 0     
-        while True:
-          values = array.array(realFormat)
-          try:
-            values.fromfile(statDatFile, nColumns)
-          except EOFError:
-            break
-            
-          for i, value in enumerate(values):
-            columns[i][index] = value
-            
-          index += 1
-          if index >= nOutput:
-            # Ignore incomplete lines
-            break
-          if subsample > 1:
-            # Ignore non-sampled lines
-            statDatFile.seek(real_size * (subsample - 1) * nColumns, 1)        
-        statDatFile.close()
-        assert(index == nOutput)
+        # memory map the little-endian binary data, ignoring any incomplete final row, so that columns
+        # (and subsampled rows) are strided views that are only read from disk when accessed
+        nRows = 0
+        if nColumns > 0:
+          nRows = os.path.getsize(filename + ".dat") // (nColumns * real_size)
+        if nRows > 0:
+          data = numpy.memmap(filename + ".dat", dtype='<f%d' % real_size, mode='r', shape=(nRows, nColumns))
+        else:
+          data = numpy.empty((0, nColumns))
+        columns = data[::subsample].T
       else:
         columns = [[] for i in range(nColumns)]
         lineNo = 0